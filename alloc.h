@@ -20,9 +20,107 @@
 #ifndef __ALLOC_H__
 #define __ALLOC_H__
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 template<class Type>
  int Malloc(Type *&Data, size_t Size)
 { Data = (Type *)malloc(Size*sizeof(Type)); return Data ? Size:0; }
 
+const size_t SIMD_Align = 64;                        // [bytes] enough for AVX-512 and a cache line
+
+inline void *AlignedMalloc(size_t Bytes)             // free() with free()
+{ void *Ptr=0; if(posix_memalign(&Ptr, SIMD_Align, Bytes ? Bytes:1)!=0) return 0;
+  return Ptr; }
+
+// ==================================================================================================
+// A fixed number of equal, page-aligned memory blocks allocated in advance: Get() and Put() are lock-free
+// and never call the system, thus a real-time thread can take large buffers without page faults
+// or a malloc() lock. The memory can be backed by huge pages and prefaulted (touched) at Preset().
+
+class MemoryPool
+{ public:
+   size_t    BlockSize;                              // [bytes] size of every block, a multiple of the page size
+   int       Blocks;                                 // number of blocks
+   int       HugePages;                              // [bool] the memory is backed by (explicit) huge pages
+   uint32_t  Misses;                                 // requests which could not be served: too big or no free block
+
+  private:
+   uint8_t  *Memory;                                 // all the blocks in one mapping
+   size_t    MapSize;                                // [bytes] size of the mapping
+   uint32_t *Next;                                   // free list links: index of the next free block
+   uint64_t  Head;                                   // free list head: [63..32] = change count against ABA, [31..0] = block index
+   int       FreeBlocks;
+   static const uint32_t None = 0xFFFFFFFF;
+
+  public:
+   MemoryPool() { BlockSize=0; Blocks=0; HugePages=0; Misses=0; Memory=0; MapSize=0; Next=0; Head=None; FreeBlocks=0; }
+  ~MemoryPool() { Free(); }
+
+   void Free(void)
+   { if(Memory) munmap(Memory, MapSize);
+     free(Next); Memory=0; MapSize=0; Next=0; Head=None; Blocks=0; FreeBlocks=0; BlockSize=0; HugePages=0; }
+
+   // Huge = try explicit huge pages (MAP_HUGETLB) first, Prefault = touch all the memory now
+   int Preset(int Blocks, size_t BlockSize, int Huge=0, int Prefault=1)
+   { Free(); if( (Blocks<=0) || (BlockSize==0) ) return 0;
+     size_t Page = sysconf(_SC_PAGESIZE);
+     BlockSize = ((BlockSize+Page-1)/Page)*Page;
+     MapSize = (size_t)Blocks*BlockSize;
+     void *Map=MAP_FAILED;
+#ifdef MAP_HUGETLB
+     if(Huge)
+     { const size_t HugeSize = 2*1024*1024;          // the common huge page size
+       size_t HugeMap = ((MapSize+HugeSize-1)/HugeSize)*HugeSize;
+       Map = mmap(0, HugeMap, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+       if(Map!=MAP_FAILED) { MapSize=HugeMap; HugePages=1; } }
+#endif
+     if(Map==MAP_FAILED)
+     { Map = mmap(0, MapSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+       if(Map==MAP_FAILED) { MapSize=0; return -1; }
+#ifdef MADV_HUGEPAGE
+       if(Huge) madvise(Map, MapSize, MADV_HUGEPAGE);  // at least transparent huge pages
+#endif
+     }
+     Memory=(uint8_t *)Map;
+     if(Prefault) memset(Memory, 0, MapSize);        // page faults now rather than in the middle of a time slot
+     Next = (uint32_t *)malloc(Blocks*sizeof(uint32_t)); if(Next==0) { Free(); return -1; }
+     for(int Idx=0; Idx<Blocks; Idx++) Next[Idx] = Idx+1<Blocks ? Idx+1:None;
+     this->Blocks=Blocks; this->BlockSize=BlockSize; FreeBlocks=Blocks; Head=0;
+     return Blocks; }
+
+   void *Get(size_t Bytes)                           // returns 0 when too big or no free block
+   { if(Bytes>BlockSize) { __atomic_add_fetch(&Misses, 1, __ATOMIC_RELAXED); return 0; }
+     uint64_t Old=__atomic_load_n(&Head, __ATOMIC_ACQUIRE);
+     for( ; ; )
+     { uint32_t Idx=(uint32_t)Old; if(Idx==None) { __atomic_add_fetch(&Misses, 1, __ATOMIC_RELAXED); return 0; }
+       uint64_t New = ((Old>>32)+1)<<32 | __atomic_load_n(Next+Idx, __ATOMIC_RELAXED);
+       if(__atomic_compare_exchange_n(&Head, &Old, New, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+       { __atomic_sub_fetch(&FreeBlocks, 1, __ATOMIC_RELAXED); return Memory+(size_t)Idx*BlockSize; }
+     }
+   }
+
+   int Put(void *Ptr)                                // returns 0 when the memory is not from this pool
+   { if(!isOwner(Ptr)) return 0;
+     uint32_t Idx = ((uint8_t *)Ptr-Memory)/BlockSize;
+     uint64_t Old=__atomic_load_n(&Head, __ATOMIC_RELAXED);
+     for( ; ; )
+     { __atomic_store_n(Next+Idx, (uint32_t)Old, __ATOMIC_RELAXED);
+       uint64_t New = ((Old>>32)+1)<<32 | Idx;
+       if(__atomic_compare_exchange_n(&Head, &Old, New, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) break; }
+     __atomic_add_fetch(&FreeBlocks, 1, __ATOMIC_RELAXED);
+     return 1; }
+
+   int isOwner(const void *Ptr) const
+   { return Memory && ((const uint8_t *)Ptr>=Memory) && ((const uint8_t *)Ptr<(Memory+(size_t)Blocks*BlockSize)); }
+
+   int getFree(void) const { return __atomic_load_n(&FreeBlocks, __ATOMIC_RELAXED); }
+   uint32_t getMisses(void) const { return __atomic_load_n(&Misses, __ATOMIC_RELAXED); }
+
+} ;
+
+// ==================================================================================================
+
 #endif
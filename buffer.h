@@ -25,10 +25,14 @@
 
 #include <string.h>
 
+#include <vector>
+
 #include "fft.h"
 #include "r2fft.h"
 
 #include "serialize.h"
+#include "simdconv.h"
+#include "alloc.h"
 
 // ==================================================================================================
 
@@ -43,19 +47,27 @@ template <class Type>
    double Time;   // [sec] time when samples were acquired
    double Freq;   // [Hz]  RF frequency where samples were acquired
    uint32_t Date; // [sec] integer part of Time to keep precision
+   double Produced; // [sec] system time when the acquisition passed it on: for the latency statistics
+   double Queued; // [sec] system time when put into the current queue: for the wait statistics
 
-   Type  *Data;  // (allocated) storage
+   Type  *Data;  // (allocated) storage: aligned for SIMD and FFTW
+   MemoryPool *Pool; // when set, the storage is taken from this pool (if a block is big enough and free)
 
   public:
-   SampleBuffer() { Size=0; Data=0; Full=0; Len=1; Time=0; Date=0; }
+   SampleBuffer() { Size=0; Data=0; Full=0; Len=1; Time=0; Date=0; Produced=0; Queued=0; Pool=0; }
   ~SampleBuffer() { Free(); }
 
-   void Free(void) { if(Data) delete [] Data; Data=0; Size=0; Full=0; }
+   void Free(void)
+   { if(Data) { if( (Pool==0) || (!Pool->Put(Data)) ) free(Data); }
+     Data=0; Size=0; Full=0; }
 
    int Allocate(int NewSize)
    { if(NewSize<=Size) { Full=0; return Size; } // for timing eficiency: do not reallocate if same or bigger size already allocated
      Free();
-     Data = new (std::nothrow) Type [NewSize]; if(Data==0) { Size=0; Full=0; return Size; }
+     void *Mem=0; size_t Bytes=(size_t)NewSize*sizeof(Type);
+     if(Pool) Mem=Pool->Get(Bytes);
+     if(Mem==0) Mem=AlignedMalloc(Bytes);
+     Data = (Type *)Mem; if(Data==0) { Size=0; Full=0; return Size; }
      Size=NewSize; return Size; }
 
    int Allocate(int NewLen, int Samples)
@@ -160,12 +172,14 @@ template <class Type>
    { int Total=0, Bytes;
      int32_t NewSize=0;
      Bytes=Serialize_ReadData(File, &NewSize, sizeof(int32_t)); if(Bytes<0) return -1;
-     if(NewSize<0) return -1;
+     if( (NewSize<0) || ((uint64_t)NewSize*sizeof(Type)>(uint64_t)Serialize_MaxRecord) ) return -1;
      Total+=Bytes;
      if(Allocate(NewSize)==0) return -2;
      Bytes=Serialize_ReadData(File, &Full, sizeof(int32_t)); if(Bytes<0) return -1;
+     if( (Full<0) || (Full>Size) ) { Full=0; return -1; }                // protect against corrupted data
      Total+=Bytes;
      Bytes=Serialize_ReadData(File, &Len , sizeof(int32_t)); if(Bytes<0) return -1;
+     if(Len<=0) { Len=1; Full=0; return -1; }
      Total+=Bytes;
      Bytes=Serialize_ReadData(File, &Rate, sizeof(double)); if(Bytes<0) return -1;
      Total+=Bytes;
@@ -178,6 +192,21 @@ template <class Type>
      Total+=Bytes;
      return Total; }
 
+   const Type *DeserializeInPlace(Serialize_Reader *File) // header as Deserialize() but the data stays in the reader (until its next read):
+   { const uint8_t *Head=(const uint8_t *)File->Get(3*sizeof(int32_t)+3*sizeof(double)); // returns a pointer to it or 0 on error.
+     if(Head==0) return 0;                                              // Size and Data of this buffer are not touched.
+     int32_t NewFull, NewLen; double FullTime;
+     memcpy(&NewFull,  Head+1*sizeof(int32_t), sizeof(int32_t));
+     memcpy(&NewLen,   Head+2*sizeof(int32_t), sizeof(int32_t));
+     if( (NewFull<0) || (NewLen<=0) ) return 0;                           // protect against corrupted data
+     if((uint64_t)NewFull*sizeof(Type)>(uint64_t)Serialize_MaxRecord) return 0;
+     Full=NewFull; Len=NewLen;
+     memcpy(&Rate,     Head+3*sizeof(int32_t),                  sizeof(double));
+     memcpy(&FullTime, Head+3*sizeof(int32_t)+sizeof(double),   sizeof(double));
+     memcpy(&Freq,     Head+3*sizeof(int32_t)+2*sizeof(double), sizeof(double));
+     Date=(uint32_t)floor(FullTime); Time=FullTime-Date;
+     return (const Type *)File->GetAligned(Full*sizeof(Type)); }
+
    int Write(FILE *File) // write all samples onto a binary file (with header)
    { if(fwrite(&Size, sizeof(Size), 1, File)!=1) return -1;
      if(fwrite(&Full, sizeof(Full), 1, File)!=1) return -1;
@@ -213,11 +242,75 @@ template <class Type>
      fclose(File); return Ret; }
 } ;
 
+// --------------------------------------------------------------------------------------------------
+// SampleBuffer shared between threads: it is created with one reference, every other user takes
+// one more with Acquire() and every user gives it back with Release(): the last one deletes it,
+// or gives it back to its RefSampleBufferSet for reuse.
+
+template <class Type> class RefSampleBufferSet;
+
+template <class Type>
+ class RefSampleBuffer : public SampleBuffer<Type>
+{ private:
+   int RefCount;
+
+  public:
+   RefSampleBufferSet<Type> *Owner;                           // when set, Release() gives the buffer back there
+
+  public:
+   RefSampleBuffer() { RefCount=1; Owner=0; }
+
+   void Reset(void) { __atomic_store_n(&RefCount, 1, __ATOMIC_RELAXED); } // taken again from the set: one reference
+   RefSampleBuffer<Type> *Acquire(void) { __atomic_add_fetch(&RefCount, 1, __ATOMIC_RELAXED); return this; }
+   void Release(void);
+} ;
+
+template <class Type>
+ class RefSampleBufferSet                                    // a few RefSampleBuffers kept for reuse: lock-free, for any thread
+{ public:
+   static const int MaxBuffers = 8;
+   RefSampleBuffer<Type> *Free[MaxBuffers];                  // null = empty place
+
+  public:
+   RefSampleBufferSet() { for(int Idx=0; Idx<MaxBuffers; Idx++) Free[Idx]=0; }
+  ~RefSampleBufferSet() { for(int Idx=0; Idx<MaxBuffers; Idx++) delete Free[Idx]; }
+
+   RefSampleBuffer<Type> *Get(void)                          // a free buffer with one reference or 0 when none
+   { for(int Idx=0; Idx<MaxBuffers; Idx++)
+     { RefSampleBuffer<Type> *Buffer=__atomic_exchange_n(&Free[Idx], (RefSampleBuffer<Type> *)0, __ATOMIC_ACQUIRE);
+       if(Buffer) { Buffer->Reset(); return Buffer; }
+     }
+     return 0; }
+
+   void Put(RefSampleBuffer<Type> *Buffer)                   // keep the buffer for reuse, or delete it when the set is full
+   { Buffer->Owner=this;
+     for(int Idx=0; Idx<MaxBuffers; Idx++)
+     { RefSampleBuffer<Type> *Empty=0;
+       if(__atomic_compare_exchange_n(&Free[Idx], &Empty, Buffer, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return; }
+     delete Buffer; }
+
+} ;
+
+template <class Type>
+ inline void RefSampleBuffer<Type>::Release(void)
+{ if(__atomic_sub_fetch(&RefCount, 1, __ATOMIC_ACQ_REL)) return;
+  if(Owner) Owner->Put(this); else delete this; }
+
 // ==================================================================================================
 
 // Note 1: the sliding FFT routines below take sliding step = half the FFT window size (thus SineWindow should be used)
 // Note 2: the FFT output spectra have the two halfs swapped around thus the FFT amplitude corresponding to the center frequency is in the middle
 
+template <class Float> // convert complex 8-bit samples to complex float/double, remove the bias, apply the window
+ void ConvertWindow(std::complex<Float> *Out, const uint8_t *Inp, const Float *Window, int Samples, Float Bias)
+{ for( int Idx=0; Idx<Samples; Idx++)
+  { Out[Idx] = std::complex<Float>( Window[Idx]*(Inp[0]-Bias), Window[Idx]*(Inp[1]-Bias) );
+    Inp+=2; }
+}
+
+inline void ConvertWindow(std::complex<float> *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ ConvertWindow((float *)Out, Inp, Window, Samples, Bias); }     // vectorized version from simdconv.h
+
 template <class Float>
  int SlidingFFT(SampleBuffer< std::complex<Float> > &Output, SampleBuffer<uint8_t> &Input,
                 InpSlideFFT<Float> &FFT, Float InpBias=127.38)
@@ -237,36 +330,84 @@ template <class Float> // do sliding FFT over a buffer of (complex 8-bit) sample
   int Slides=0;
   { std::complex<Float> *Buffer = FwdFFT.Buffer;                  // first slide is special
     for( int Bin=0; Bin<WindowSize2; Bin++) { Buffer[Bin] = 0; }    // half the window is empty
-    for( int Bin=WindowSize2; Bin<WindowSize; Bin++)                // the other half contains the first input samples
-    { Buffer[Bin] = std::complex<float>( Window[Bin]*(InpData[0]-InpBias), Window[Bin]*(InpData[1]-InpBias) );
-      InpData+=2; }
+    ConvertWindow(Buffer+WindowSize2, InpData, Window+WindowSize2, WindowSize2, InpBias); // the other half contains the first input samples
     FwdFFT.Execute();                                             // execute FFT
     memcpy(OutData, Buffer+WindowSize2, WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;  // copy spectra into the output buffer
     memcpy(OutData, Buffer,             WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;  // swap around the two halfs
-    InpData-=2*WindowSize2; Slides++; }
+    Slides++; }
   for( ; InpSamples>=WindowSize; InpSamples-=WindowSize2)           // now the following slides
   { std::complex<Float> *Buffer = FwdFFT.Buffer;
-    for( int Bin=0; Bin<WindowSize; Bin++)
-    { Buffer[Bin] = std::complex<float>( Window[Bin]*(InpData[0]-InpBias), Window[Bin]*(InpData[1]-InpBias) );
-      InpData+=2; }
+    ConvertWindow(Buffer, InpData, Window, WindowSize, InpBias);
     FwdFFT.Execute();
     memcpy(OutData, Buffer+WindowSize2, WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;
     memcpy(OutData, Buffer,             WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;
-    InpData-=2*WindowSize2; Slides++; }
+    InpData+=2*WindowSize2; Slides++; }
   { std::complex<Float> *Buffer = FwdFFT.Buffer;                  // and the last slide: special
-    for( int Bin=0; Bin<WindowSize2; Bin++)
-    { Buffer[Bin] = std::complex<float>( Window[Bin]*(InpData[0]-InpBias), Window[Bin]*(InpData[1]-InpBias) );
-      InpData+=2; }
+    ConvertWindow(Buffer, InpData, Window, WindowSize2, InpBias);
     for( int Bin=WindowSize2; Bin<WindowSize; Bin++)
     { Buffer[Bin] = 0; }
     FwdFFT.Execute();
     memcpy(OutData, Buffer+WindowSize2, WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;
     memcpy(OutData, Buffer,             WindowSize2*sizeof(std::complex<Float>)); OutData+=WindowSize2;
-    InpData-=2*WindowSize2; Slides++; }
+    Slides++; }
 
   Output.Full=Slides*WindowSize;
   return Slides; }
 
+// --------------------------------------------------------------------------------------------------
+// Same sliding FFT, but Batch slides are transformed at a time and the spectra go directly into the Output.
+// The half-swap is absorbed into the window: multiplying the input by (-1)^n shifts the spectra by half the FFT size,
+// thus the Window must be prepared with SwapHalfsWindow() and then the results are the same as above.
+
+template <class Float>
+ void SwapHalfsWindow(Float *Window, int WindowSize)
+{ for(int Idx=1; Idx<WindowSize; Idx+=2) Window[Idx]=(-Window[Idx]); }
+
+inline int SlidingFFT_Slides(int InpSamples, int WindowSize)    // number of slides produced by SlidingFFT() for given number of input samples
+{ int Slides=2; if(InpSamples>=WindowSize) Slides+=(InpSamples-WindowSize)/(WindowSize/2)+1;
+  return Slides; }
+
+template <class Float> // FFT of the slides [FirstSlide, LastSlide) out of Slides: Output must be allocated already
+ void SlidingFFT_Range(SampleBuffer< std::complex<Float> > &Output, const SampleBuffer<uint8_t> &Input,
+                       DFT1dBatch<Float> &FwdFFT, const Float *Window, int FirstSlide, int LastSlide, int Slides, Float InpBias=127.38)
+{ int WindowSize = FwdFFT.Size;
+  int WindowSize2=WindowSize/2;
+  int Batch=FwdFFT.Batch;
+  const uint8_t *InpData = Input.Data;
+  for( int Slide=FirstSlide; Slide<LastSlide; Slide+=Batch)
+  { int Rows=LastSlide-Slide; if(Rows>Batch) Rows=Batch;
+    for( int Row=0; Row<Rows; Row++)
+    { std::complex<Float> *Buffer = FwdFFT.Row(Row);
+      int Idx=Slide+Row;
+      if(Idx==0)                                                  // first slide: half the window is empty
+      { for( int Bin=0; Bin<WindowSize2; Bin++) { Buffer[Bin] = 0; }
+        ConvertWindow(Buffer+WindowSize2, InpData, Window+WindowSize2, WindowSize2, InpBias); }
+      else if(Idx==(Slides-1))                                    // last slide: the other half is empty
+      { ConvertWindow(Buffer, InpData+2*(Idx-1)*WindowSize2, Window, WindowSize2, InpBias);
+        for( int Bin=WindowSize2; Bin<WindowSize; Bin++) { Buffer[Bin] = 0; } }
+      else
+        ConvertWindow(Buffer, InpData+2*(Idx-1)*WindowSize2, Window, WindowSize, InpBias);
+    }
+    std::complex<Float> *OutData = Output.Data+Slide*WindowSize;
+    if( (Rows==Batch) && FwdFFT.isAligned(OutData) ) FwdFFT.Execute(OutData); // spectra directly into the output buffer
+    else                                                          // or through the FFT own output for a partial batch or when alignment is not right
+    { FwdFFT.Execute(); memcpy(OutData, FwdFFT.Output, Rows*WindowSize*sizeof(std::complex<Float>)); }
+  }
+}
+
+template <class Float> // do sliding FFT over a buffer of (complex 8-bit) samples, Batch slides at a time
+ int SlidingFFT(SampleBuffer< std::complex<Float> > &Output, SampleBuffer<uint8_t> &Input,
+                DFT1dBatch<Float> &FwdFFT, Float *Window, Float InpBias=127.38)
+{ int WindowSize = FwdFFT.Size;                                                        // FFT object and Window shape are prepared already
+  int WindowSize2=WindowSize/2;                                                        // Slide step
+  int InpSamples=Input.Full/2;                                                         // number of complex,8-bit input samples
+  int Slides=SlidingFFT_Slides(InpSamples, WindowSize);                                // same slides as the single FFT version
+  Output.Allocate(Slides*WindowSize); Output.Len=WindowSize;                           // output is rows of spectral data
+  Output.Rate=Input.Rate/WindowSize2; Output.Time=Input.Time; Output.Date=Input.Date; Output.Freq=Input.Freq;
+  SlidingFFT_Range(Output, Input, FwdFFT, Window, 0, Slides, Slides, InpBias);
+  Output.Full=Slides*WindowSize;
+  return Slides; }
+
 // --------------------------------------------------------------------------------------------------
 
 template <class Float> // do sliding FFT over a buffer of float/double complex samples, produce (float/double complex) spectra
@@ -594,6 +735,132 @@ template <class Float>
  int Spectrogram(SampleBuffer<Float> &SpectraPower, const char *ImageFileName, Float RefPwr=1.00)
 { return Spectrogram(SpectraPower.Data, SpectraPower.Samples(), SpectraPower.Len, ImageFileName, RefPwr); }
 
+// ==================================================================================================
+// Polyphase filter bank channelizer: decimated complex baseband of a few selected channels, as an
+// alternative to the sliding FFT over the whole band. The band is split into Bands (M, even) bands of
+// Rate/M each and every output sample is produced from M/2 new input samples (2x oversampled, thus a
+// prototype filter wider than the band spacing does not alias). For a channel only its own band is
+// computed (one M-point DFT output per sample instead of the full FFT) and the remaining offset
+// between the channel and the band center is removed with a numerically controlled oscillator.
+// Per input sample this costs (M*TapsPerBand + Channels*M)/(M/2) complex-real MACs.
+
+template <class Float>
+ class PolyphaseChannelizer
+{ public:
+   static const int MaxChannels = 4;
+   int     Bands;                                   // M: number of bands over the sampled bandwidth, even
+   int     TapsPerBand;                             // prototype filter length = Bands*TapsPerBand
+   Float   Cutoff;                                  // prototype half-bandwidth relative to the band spacing: the output Nyquist is 1.0
+   Float   InpBias;                                 // for the 8-bit input
+
+   std::vector<Float> Proto;                        // prototype lowpass filter, unity gain at DC
+   std::vector< std::complex<Float> > Twiddle;      // exp(j*2*pi*m/M)
+
+   int      Channels;                               // of the last slot
+   uint32_t Freq[MaxChannels];                      // [Hz] channel frequencies
+   int      Band[MaxChannels];                      // band index of every channel, 0..M-1
+   double   Offset[MaxChannels];                    // [Hz] from the band center to the channel
+   SampleBuffer< std::complex<Float> > Output;      // [Channels][Samples]: Len = samples per channel
+
+  private:
+   std::vector< std::complex<Float> > Input;        // the slot as complex Float
+   std::vector< std::complex<Float> > Poly;         // M polyphase partial sums for one output sample
+
+  public:
+   PolyphaseChannelizer() { Bands=0; TapsPerBand=12; Cutoff=0.9; InpBias=127.38; Channels=0; }
+
+   int Preset(int Bands, int TapsPerBand=12)        // design the prototype filter (windowed sinc, Blackman window)
+   { if( (Bands<2) || (Bands&1) || (TapsPerBand<1) ) return -1;
+     this->Bands=Bands; this->TapsPerBand=TapsPerBand;
+     int Taps=Bands*TapsPerBand;
+     Proto.resize(Taps); Twiddle.resize(Bands); Poly.resize(Bands);
+     double Fc=Cutoff/Bands;                        // [cycles/sample]
+     double Center=0.5*(Taps-1), Sum=0;
+     for(int Tap=0; Tap<Taps; Tap++)
+     { double X=Tap-Center;
+       double Sinc = (X==0) ? 2*Fc : sin(2*M_PI*Fc*X)/(M_PI*X);
+       double Phase=2*M_PI*Tap/(Taps-1);
+       double Window = 0.42-0.5*cos(Phase)+0.08*cos(2*Phase);
+       Proto[Tap]=Sinc*Window; Sum+=Proto[Tap]; }
+     for(int Tap=0; Tap<Taps; Tap++) Proto[Tap]/=Sum;
+     for(int m=0; m<Bands; m++) Twiddle[m]=std::complex<Float>(cos(2*M_PI*m/Bands), sin(2*M_PI*m/Bands));
+     return Taps; }
+
+   static int AutoBands(double Rate, double ChanSepar) // even number of bands nearest to one per hopping channel
+   { int Bands=2*(int)floor(0.5*Rate/ChanSepar+0.5); return Bands<2 ? 2:Bands; }
+
+   double getDelay(double Rate) const { return 0.5*(Bands*TapsPerBand-1)/Rate; } // [sec] group delay of the prototype filter
+
+   int Process(SampleBuffer<uint8_t> &Inp, const uint32_t *ChanFreq, int Chans) // 8-bit I/Q input: returns the number of channels
+   { int Samples=Inp.Full/2;
+     Input.resize(Samples);
+     const uint8_t *Src=Inp.Data;
+     for(int Idx=0; Idx<Samples; Idx++, Src+=2)
+       Input[Idx]=std::complex<Float>(Src[0]-InpBias, Src[1]-InpBias);
+     return Process(Input.data(), Samples, Inp.Rate, Inp.Freq, Inp.Time, Inp.Date, ChanFreq, Chans); }
+
+   int Process(SampleBuffer< std::complex<Float> > &Inp, const uint32_t *ChanFreq, int Chans) // complex input, e.g. after the tone filter
+   { return Process(Inp.Data, Inp.Full, Inp.Rate, Inp.Freq, Inp.Time, Inp.Date, ChanFreq, Chans); }
+
+   int Process(const std::complex<Float> *Data, int Samples, double Rate, double CenterFreq, double Time, uint32_t Date,
+               const uint32_t *ChanFreq, int Chans)
+   { if(Bands<2) return -1;
+     int Decim=Bands/2, Taps=Bands*TapsPerBand;
+     double Spacing=Rate/Bands;                     // [Hz] band spacing
+     Channels=0;
+     for(int Chan=0; Chan<Chans; Chan++)            // the band of every channel within the sampled bandwidth
+     { double Diff=ChanFreq[Chan]-CenterFreq;
+       int Idx=(int)floor(Diff/Spacing+0.5);
+       if( (Idx<=(-Bands/2)) || (Idx>=(Bands/2)) ) continue;
+       if(Channels>=MaxChannels) break;
+       Freq[Channels]=ChanFreq[Chan]; Band[Channels]=(Idx+Bands)%Bands; Offset[Channels]=Diff-Idx*Spacing;
+       Channels++; }
+     int OutSamples=(Samples+Decim-1)/Decim;
+     Output.Allocate(Channels*OutSamples); Output.Full=Channels*OutSamples; Output.Len=OutSamples;
+     Output.Rate=Rate/Decim; Output.Freq=CenterFreq; Output.Date=Date; Output.Time=Time-getDelay(Rate);
+     std::complex<Float> NCO[MaxChannels], Step[MaxChannels];
+     for(int Chan=0; Chan<Channels; Chan++)
+     { NCO[Chan]=1; double Phase=-2*M_PI*Offset[Chan]/Output.Rate; Step[Chan]=std::complex<Float>(cos(Phase), sin(Phase)); }
+     for(int Out=0; Out<OutSamples; Out++)
+     { int Pos=Out*Decim;                           // the newest input sample for this output
+       for(int m=0; m<Bands; m++)                   // polyphase partial sums: v[m] = sum h[m+l*M] x[Pos-m-l*M]
+       { std::complex<Float> Sum=0;
+         for(int Tap=m, Idx=Pos-m; (Tap<Taps) && (Idx>=0); Tap+=Bands, Idx-=Bands) Sum+=Proto[Tap]*Data[Idx];
+         Poly[m]=Sum; }
+       for(int Chan=0; Chan<Channels; Chan++)       // only the DFT outputs of the selected bands
+       { std::complex<Float> Sum=0; int k=Band[Chan];
+         for(int m=0, Tw=0; m<Bands; m++, Tw+=k) { if(Tw>=Bands) Tw-=Bands; Sum+=Twiddle[Tw]*Poly[m]; }
+         if((k*Out)&1) Sum=(-Sum);                  // exp(-j*2*pi*k*Out*Decim/M) with Decim=M/2
+         Output.Data[Chan*OutSamples+Out]=Sum*NCO[Chan]; NCO[Chan]*=Step[Chan]; }
+       if((Out&1023)==1023)                         // keep the NCO amplitude at 1
+         for(int Chan=0; Chan<Channels; Chan++) NCO[Chan]/=abs(NCO[Chan]);
+     }
+     return Channels; }
+
+  template <class StreamType>
+   int SerializeHeader(StreamType File)             // channel count and frequencies
+   { int Total=0, Bytes;
+     int32_t Count=Channels;
+     Bytes=Serialize_WriteData(File, &Count, sizeof(int32_t)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, Freq, Channels*sizeof(uint32_t)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     return Total; }
+
+  template <class StreamType>
+   int Serialize(StreamType File)                   // the header, then the I/Q of all channels as a SampleBuffer
+   { int Total=SerializeHeader(File); if(Total<0) return -1;
+     int Bytes=Output.Serialize(File); if(Bytes<0) return -1;
+     return Total+Bytes; }
+
+  template <class StreamType, class EncoderType>
+   int Serialize(StreamType File, EncoderType *Encoder) // the same with an encoder (SpectraEncoder) which has Encode()'d the Output
+   { int Total=SerializeHeader(File); if(Total<0) return -1;
+     int Bytes=Encoder->Serialize(File, Output); if(Bytes<0) return -1;
+     return Total+Bytes; }
+
+} ;
+
 // ==================================================================================================
 
 #endif // __BUFFER_H_
@@ -0,0 +1,83 @@
+#ifndef __CHANSPECTRA_H__
+#define __CHANSPECTRA_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <complex>
+#include <algorithm>
+
+#include "buffer.h"
+#include "serialize.h"
+#include "specenc.h"
+#include "freqplan.h"
+
+// ==================================================================================================
+// Channel-selective output of the sliding FFT: only the bins around the hopping channels which can be
+// active in the slot (FLARM and OGN, both time slots of the second, as FreqPlan::getFrequency()) are
+// sent, Width wide plus GuardBins on both sides. The record lists the channel frequencies and their
+// first bins in the full spectra, then the bins of every channel for all slides, channel after channel.
+
+template <class Float>
+ class ChannelSpectra
+{ public:
+   static const int MaxChannels = 4;                // two time slots x (FLARM + OGN)
+   int      Width;                                  // [Hz] signal bandwidth of a channel
+   int      GuardBins;                              // [bins] added on both sides
+
+   int      Len;                                    // [bins] per slide in the full spectra
+   int      Slides;
+   int      Bins;                                   // [bins] per channel
+   int      Channels;                               // number of channels in the last slot
+   double   Freq[MaxChannels];                      // [Hz] channel frequencies
+   int32_t  FirstBin[MaxChannels];                  // first bin of the channel in the full spectra
+   SampleBuffer< std::complex<Float> > Output;      // [Channels][Slides][Bins]
+
+  public:
+   ChannelSpectra() { Width=200000; GuardBins=4; Len=0; Slides=0; Bins=0; Channels=0; }
+
+   int Process(const SampleBuffer< std::complex<Float> > &Spectra, const FreqPlan &Plan) // returns the number of channels
+   { Len=Spectra.Len; Slides=Spectra.Full/Len; Channels=0;
+     double BinWidth = Spectra.Rate/2;                               // [Hz] Rate is the slide rate: slides overlap by half
+     if(BinWidth<=0) return 0;
+     Bins = 2*(int)ceil(0.5*Width/BinWidth) + 2*GuardBins; if(Bins>Len) Bins=Len;
+     uint32_t Time = (uint32_t)floor(Spectra.Time+Spectra.Date);
+     uint32_t HopFreq[MaxChannels];
+     int Active=Plan.getActiveFrequencies(HopFreq, Time);
+     for(int Idx=0; Idx<Active; Idx++)
+     { int Center = Len/2 + (int)floor((HopFreq[Idx]-Spectra.Freq)/BinWidth+0.5); // the spectra are centered on Freq
+       if( (Center<0) || (Center>=Len) ) continue;                   // outside of the captured band
+       int First = Center-Bins/2;
+       if(First<0) First=0; else if(First>Len-Bins) First=Len-Bins;  // at the band edge: keep the width, shift inwards
+       Freq[Channels]=HopFreq[Idx]; FirstBin[Channels]=First; Channels++; }
+
+     Output.Allocate(Channels*Slides*Bins); Output.Len=Bins; Output.Full=Channels*Slides*Bins;
+     Output.Rate=Spectra.Rate; Output.Freq=Spectra.Freq; Output.Time=Spectra.Time; Output.Date=Spectra.Date;
+     std::complex<Float> *Dst = Output.Data;
+     for(int Chan=0; Chan<Channels; Chan++)
+     { const std::complex<Float> *Src = Spectra.Data+FirstBin[Chan];
+       for(int Slide=0; Slide<Slides; Slide++)
+       { memcpy(Dst, Src, Bins*sizeof(std::complex<Float>)); Dst+=Bins; Src+=Len; }
+     }
+     return Channels; }
+
+  template <class StreamType>
+   int Serialize(StreamType File, SpectraEncoder<Float> *Encoder=0)                   // geometry, channel frequencies and first bins, then the bins as a SampleBuffer
+   { int Total=0, Bytes;
+     int32_t Geometry[4] = { Len, Slides, Bins, Channels };
+     Bytes=Serialize_WriteData(File, Geometry, sizeof(Geometry)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, Freq, Channels*sizeof(double)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, FirstBin, Channels*sizeof(int32_t)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes = Encoder ? Encoder->Serialize(File, Output) : Output.Serialize(File); if(Bytes<0) return -1;
+     Total+=Bytes;
+     return Total; }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __CHANSPECTRA_H__
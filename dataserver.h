@@ -1,31 +1,90 @@
+#ifndef __DATASERVER_H__
+#define __DATASERVER_H__
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <vector>
+#include <deque>
 
 #include "socket.h"
+#include "thread.h"
 
 // ======================================================================================================
+// TCP server which sends the same data (serialized time slots) to many clients: every slot is serialized
+// once into a DataMessage which is shared (reference counted) by the send queues of all the clients.
+// The sockets are non-blocking and served by an own I/O thread with epoll, thus a slow client only lets
+// its own queue grow: beyond MaxQueue messages its oldest (not yet started) messages are dropped.
+
+class TCP_DataServer;
+
+class DataMessage                              // a serialized time slot, freed when sent to all the clients
+{ public:
+   uint8_t        *Data;
+   int             Len;                        // [bytes] data in the message
+   int             Size;                       // [bytes] allocated
+   double          Time;                       // [sec] acquisition time of the slot, to measure the lag of the clients
+   int             RefCount;
+   TCP_DataServer *Owner;                      // given back to this server for reuse
+
+  public:
+   DataMessage() { Data=0; Len=0; Size=0; Time=0; RefCount=1; Owner=0; }
+  ~DataMessage() { free(Data); }
+
+   int Append(const void *Bytes, int Count)
+   { if(Len+Count>Size)
+     { int NewSize=Size ? Size:4096; while(NewSize<Len+Count) NewSize*=2;
+       uint8_t *NewData=(uint8_t *)realloc(Data, NewSize); if(NewData==0) return -1;
+       Data=NewData; Size=NewSize; }
+     memcpy(Data+Len, Bytes, Count); Len+=Count; return Count; }
+
+   DataMessage *Acquire(void) { __atomic_add_fetch(&RefCount, 1, __ATOMIC_RELAXED); return this; }
+   void Release(void);                         // below, after TCP_DataServer
+} ;
+
+// so the Serialize...() functions can write into a DataMessage
+inline int Serialize_WriteSync(DataMessage *Msg, uint32_t Sync)               { return Msg->Append(&Sync, sizeof(uint32_t)); }
+inline int Serialize_WriteName(DataMessage *Msg, const char *Name)            { return Msg->Append(Name, strlen(Name)+1); }
+inline int Serialize_WriteData(DataMessage *Msg, const void *Data, int Bytes) { return Msg->Append(Data, Bytes); }
 
 class TCP_DataServer
 { public:
-   int Server;
-   std::vector<int> Client;
+   int MaxQueue;                               // [messages] per client, beyond this the oldest messages are dropped
+
+  private:
+   struct Client
+   { int      Socket;
+     char     Name[24];                        // address:port
+     std::deque<DataMessage *> Queue;          // messages to be sent, the first one possibly partially sent already
+     int      Offset;                          // [bytes] sent of the first message
+     int      WantOut;                         // [bool] waiting for EPOLLOUT
+     uint32_t Sent;                            // messages sent
+     uint32_t Dropped;                         // messages dropped because the queue was full
+   } ;
+
+   int    Server;                              // listening socket
+   int    Poll;                                // epoll descriptor
+   int    Wakeup;                              // eventfd: Send() wakes up the I/O thread here
+   std::vector<Client *> ClientList;
+   int    ClientCount;
+   MessageQueue<DataMessage *> Inbox;          // messages from Send() to the I/O thread
+   std::vector<DataMessage *>  Spare;          // messages for reuse
+   MutEx  Mutex;                               // for ClientList: the I/O thread and Status()
+   MutEx  SpareMutex;                          // for Spare: Release() can be called by any thread
+   Thread Thr;
+   volatile int StopReq;
 
   public:
-   TCP_DataServer() { BlockSIGPIPE(); Server=(-1); }
+   TCP_DataServer() { Server=(-1); Poll=(-1); Wakeup=(-1); ClientCount=0; MaxQueue=4; StopReq=0; }
   ~TCP_DataServer() { Close(); }
 
-   void static BlockSIGPIPE(void)
-   { sigset_t set;                             // disable SIGPIPE signal for the current thread when writing to a closed socket
-     sigemptyset (&set);                       // this is required for the DataServer to function properly.
-     sigaddset (&set, SIGPIPE);
-     pthread_sigmask(SIG_BLOCK, &set, 0); }
-
-   int Listen(int Port, int MaxCons=16)
+   int Listen(int Port, int MaxCons=16)        // open the port and start the I/O thread
    { Close();
      Server = socket(AF_INET, SOCK_STREAM, 0); if(Server<0) return -1;
 
@@ -45,47 +104,167 @@ class TCP_DataServer
 
      if(listen(Server, MaxCons)<0) { Close(); return -1; }
 
+     Poll = epoll_create1(0); if(Poll<0) { Close(); return -1; }
+     Wakeup = eventfd(0, EFD_NONBLOCK); if(Wakeup<0) { Close(); return -1; }
+     struct epoll_event Event;
+     Event.events=EPOLLIN; Event.data.ptr=&Server; epoll_ctl(Poll, EPOLL_CTL_ADD, Server, &Event);
+     Event.events=EPOLLIN; Event.data.ptr=&Wakeup; epoll_ctl(Poll, EPOLL_CTL_ADD, Wakeup, &Event);
+
+     StopReq=0; Thr.setExec(ThreadExec);
+     if(Thr.Create(this)!=0) { Close(); return -1; }
      return 0; }
 
-   int Clients(void) const { return Client.size(); }
-
-   int Accept(void)
-   { int Count=0;
-     for( ; ; )
-     { struct sockaddr Addr; socklen_t Len;
-       int New=accept(Server, &Addr, &Len); if(New<0) break;
-       // int Flag = 1;
-       // setsockopt(New, SOL_SOCKET, SO_NOSIGPIPE, &Flag, sizeof(Flag));
-       printf("Accepted a new client: %d\n", New);
-       Client.push_back(New); Count++; }
-     return Count; }
-
-   void Close(size_t Idx)
-   { if(Idx>=Client.size()) return;
-     close(Client[Idx]); Client[Idx]=(-1); }
-
-   int RemoveClosed(void)
-   { int Count=0;
-     for(size_t Idx=0; Idx<Client.size(); )
-     { if(Client[Idx]<0)
-       { size_t NewSize=Client.size()-1;
-         Client[Idx]=Client[NewSize];
-         Client.resize(NewSize);
-         Count++; }
-       Idx++; }
-     return Count; }
+   int isListenning(void) const { return Server>=0; }
 
-   void Close(void)
+   int Clients(void) const { return __atomic_load_n(&ClientCount, __ATOMIC_RELAXED); }
+
+   DataMessage *New(void)                      // an empty message to serialize a slot into
+   { DataMessage *Msg=0;
+     SpareMutex.Lock();
+     if(!Spare.empty()) { Msg=Spare.back(); Spare.pop_back(); }
+     SpareMutex.Unlock();
+     if(Msg==0) { Msg = new DataMessage; Msg->Owner=this; }
+     Msg->Len=0; Msg->RefCount=1; return Msg; }
+
+   void Send(DataMessage *Msg)                 // queue the message to all clients: does not block, the caller still has to Release() it
    { if(Server<0) return;
-     for(size_t Idx=0; Idx<Client.size(); Idx++)
-     { if(Client[Idx]>=0) close(Client[Idx]); }
-     Client.resize(0);
-     close(Server); Server=(-1);
+     Inbox.Push(Msg->Acquire());
+     uint64_t One=1; if(write(Wakeup, &One, sizeof(One))<0) { } }
+
+   void Recycle(DataMessage *Msg)              // called by DataMessage::Release()
+   { SpareMutex.Lock();
+     if((int)Spare.size()<(MaxQueue+2)) { Spare.push_back(Msg); Msg=0; }
+     SpareMutex.Unlock();
+     delete Msg; }
+
+   int Status(char *Out, int MaxLen, double Now, const char *Sep="\n") // one line per client: queue, lag, sent and dropped messages
+   { int Len=0; Out[0]=0;
+     Mutex.Lock();
+     for(size_t Idx=0; Idx<ClientList.size(); Idx++)
+     { Client *Cli=ClientList[Idx];
+       double Lag = Cli->Queue.empty() ? 0:Now-Cli->Queue.front()->Time;
+       if(Len>(MaxLen-128)) break;
+       Len+=sprintf(Out+Len, "%s%s: %d queued, %3.1f s lag, %d sent, %d dropped", Idx ? Sep:"",
+                    Cli->Name, (int)Cli->Queue.size(), Lag, Cli->Sent, Cli->Dropped); }
+     Mutex.Unlock();
+     return Len; }
+
+   void Close(void)
+   { Stop();
+     for(size_t Idx=0; Idx<ClientList.size(); Idx++) Remove(ClientList[Idx], 0);
+     Purge();
+     DataMessage *Msg; while(Inbox.Size()) { Inbox.Pop(Msg); Msg->Release(); }
+     for(size_t Idx=0; Idx<Spare.size(); Idx++) delete Spare[Idx];
+     Spare.resize(0);
+     if(Server>=0) { close(Server); Server=(-1); }
+     if(Poll>=0)   { close(Poll);   Poll=(-1); }
+     if(Wakeup>=0) { close(Wakeup); Wakeup=(-1); }
    }
 
-   int isListenning(void) const { return Server>=0; }
+  private:
+   void Stop(void)                             // stop the I/O thread
+   { if(Poll<0) return;
+     StopReq=1;
+     if(Wakeup>=0) { uint64_t One=1; if(write(Wakeup, &One, sizeof(One))<0) { } }
+     Thr.Join(); }
+
+   static void *ThreadExec(void *Context)
+   { TCP_DataServer *This = (TCP_DataServer *)Context; return This->Exec(); }
+
+   void *Exec(void)
+   { struct epoll_event Event[16];
+     while(!StopReq)
+     { int Events=epoll_wait(Poll, Event, 16, 1000);
+       if(Events<0) { if(errno==EINTR) continue; printf("TCP_DataServer.Exec() ... epoll_wait() failed\n"); break; }
+       Mutex.Lock();
+       for(int Idx=0; Idx<Events; Idx++)
+       { void *Ptr=Event[Idx].data.ptr;
+         if(Ptr==&Server) Accept();
+         else if(Ptr==&Wakeup) Distribute();
+         else Serve((Client *)Ptr, Event[Idx].events); }
+       Purge();                                // the batch can still hold events of a client removed meanwhile: free only now
+       Mutex.Unlock(); }
+     return 0; }
+
+   void Accept(void)
+   { for( ; ; )
+     { struct sockaddr_in Addr; socklen_t Len=sizeof(Addr);
+       int New=accept(Server, (struct sockaddr *)&Addr, &Len); if(New<0) break;
+       int Flags = fcntl(New, F_GETFL, 0); fcntl(New, F_SETFL, Flags|O_NONBLOCK);
+       Client *Cli = new Client;
+       Cli->Socket=New; Cli->Offset=0; Cli->WantOut=0; Cli->Sent=0; Cli->Dropped=0;
+       snprintf(Cli->Name, sizeof(Cli->Name), "%s:%d", inet_ntoa(Addr.sin_addr), ntohs(Addr.sin_port));
+       struct epoll_event Event; Event.events=EPOLLIN; Event.data.ptr=Cli;
+       epoll_ctl(Poll, EPOLL_CTL_ADD, New, &Event);
+       ClientList.push_back(Cli); __atomic_store_n(&ClientCount, (int)ClientList.size(), __ATOMIC_RELAXED);
+       printf("TCP_DataServer.Accept() ... new client %s (%d clients now)\n", Cli->Name, (int)ClientList.size()); }
+   }
+
+   void Distribute(void)                       // new messages from Send(): into the queues of all clients
+   { uint64_t Count; if(read(Wakeup, &Count, sizeof(Count))<0) { }
+     while(Inbox.Size())
+     { DataMessage *Msg; Inbox.Pop(Msg);
+       for(size_t Idx=0; Idx<ClientList.size(); Idx++)
+       { Client *Cli=ClientList[Idx]; if(Cli->Socket<0) continue;
+         if((int)Cli->Queue.size()>=MaxQueue)  // drop the oldest message which is not being sent already
+         { size_t Drop = Cli->Offset ? 1:0;
+           if(Drop<Cli->Queue.size())
+           { Cli->Queue[Drop]->Release(); Cli->Queue.erase(Cli->Queue.begin()+Drop); Cli->Dropped++; }
+         }
+         Cli->Queue.push_back(Msg->Acquire()); }
+       Msg->Release(); }
+     for(size_t Idx=0; Idx<ClientList.size(); Idx++)
+     { Client *Cli=ClientList[Idx];
+       if( (Cli->Socket>=0) && (Flush(Cli)<0) ) Remove(Cli); }
+   }
+
+   void Serve(Client *Cli, uint32_t Events)
+   { if(Cli->Socket<0) return;                 // removed earlier in this batch
+     if(Events&EPOLLIN)                        // clients are not expected to send anything: read to detect the closing
+     { char Buffer[256]; int Len=recv(Cli->Socket, Buffer, sizeof(Buffer), MSG_DONTWAIT);
+       if( (Len==0) || ( (Len<0) && (errno!=EAGAIN) && (errno!=EWOULDBLOCK) ) ) { Remove(Cli); return; } }
+     if(Events&(EPOLLERR|EPOLLHUP)) { Remove(Cli); return; }
+     if(Events&EPOLLOUT) { if(Flush(Cli)<0) Remove(Cli); }
+   }
+
+   int Flush(Client *Cli)                      // send as much as the socket takes now: -1 on error
+   { while(!Cli->Queue.empty())
+     { DataMessage *Msg=Cli->Queue.front();
+       int Len=send(Cli->Socket, Msg->Data+Cli->Offset, Msg->Len-Cli->Offset, MSG_NOSIGNAL|MSG_DONTWAIT);
+       if(Len<0)
+       { if( (errno==EAGAIN) || (errno==EWOULDBLOCK) ) break;
+         return -1; }
+       Cli->Offset+=Len;
+       if(Cli->Offset<Msg->Len) break;
+       Cli->Queue.pop_front(); Msg->Release(); Cli->Offset=0; Cli->Sent++; }
+     int WantOut = !Cli->Queue.empty();         // wait for EPOLLOUT only when there is something left
+     if(WantOut!=Cli->WantOut)
+     { struct epoll_event Event; Event.events = EPOLLIN | (WantOut ? EPOLLOUT:0); Event.data.ptr=Cli;
+       epoll_ctl(Poll, EPOLL_CTL_MOD, Cli->Socket, &Event); Cli->WantOut=WantOut; }
+     return 0; }
+
+   void Remove(Client *Cli, int Report=1)      // close the client: it is freed later by Purge()
+   { if(Cli->Socket<0) return;
+     if(Report) printf("TCP_DataServer.Exec() ... client %s closed, %d sent, %d dropped\n", Cli->Name, Cli->Sent, Cli->Dropped);
+     epoll_ctl(Poll, EPOLL_CTL_DEL, Cli->Socket, 0);
+     close(Cli->Socket); Cli->Socket=(-1);
+     for(size_t Idx=0; Idx<Cli->Queue.size(); Idx++) Cli->Queue[Idx]->Release();
+     Cli->Queue.clear(); Cli->Offset=0; }
+
+   void Purge(void)                            // free the removed clients
+   { size_t Keep=0;
+     for(size_t Idx=0; Idx<ClientList.size(); Idx++)
+     { Client *Cli=ClientList[Idx];
+       if(Cli->Socket<0) delete Cli; else ClientList[Keep++]=Cli; }
+     ClientList.resize(Keep);
+     __atomic_store_n(&ClientCount, (int)Keep, __ATOMIC_RELAXED); }
 
 } ;
 
+inline void DataMessage::Release(void)
+{ if(__atomic_sub_fetch(&RefCount, 1, __ATOMIC_ACQ_REL)) return;
+  if(Owner) Owner->Recycle(this); else delete this; }
+
 // ======================================================================================================
 
+#endif // __DATASERVER_H__
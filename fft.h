@@ -22,6 +22,9 @@
 #define __FFT_H__
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
 #include <math.h>
 
 // #include <cmath> // for M_PI in C++11 - no, does not work
@@ -30,6 +33,42 @@
 
 #include <fftw3.h>
 
+// ===========================================================================================
+// FFTW planner rigor and wisdom, common to all the FFTs below: to be set before the plans are made.
+// With the wisdom saved to a file the expensive (MEASURE/PATIENT) planning is done only once per host.
+
+inline unsigned &FFTW_Flags(void) { static unsigned Flags=FFTW_MEASURE; return Flags; } // planner flags for all new plans
+
+inline int FFTW_setPlanner(const char *Name)                       // "estimate", "measure", "patient" or "exhaustive"
+{      if(strcasecmp(Name, "estimate"  )==0) FFTW_Flags()=FFTW_ESTIMATE;
+  else if(strcasecmp(Name, "measure"   )==0) FFTW_Flags()=FFTW_MEASURE;
+  else if(strcasecmp(Name, "patient"   )==0) FFTW_Flags()=FFTW_PATIENT;
+  else if(strcasecmp(Name, "exhaustive")==0) FFTW_Flags()=FFTW_EXHAUSTIVE;
+  else return -1;
+  return 0; }
+
+inline const char *FFTW_getPlanner(void)
+{ unsigned Flags=FFTW_Flags();
+  if(Flags&FFTW_ESTIMATE)   return "estimate";
+  if(Flags&FFTW_EXHAUSTIVE) return "exhaustive";
+  if(Flags&FFTW_PATIENT)    return "patient";
+  return "measure"; }
+
+inline int FFTW_ImportWisdom(const char *FileName)                 // single precision wisdom in FileName, double in FileName.double
+{ char DoubleName[256]; snprintf(DoubleName, 256, "%s.double", FileName);
+  int OK=fftwf_import_wisdom_from_filename(FileName);
+  fftw_import_wisdom_from_filename(DoubleName);
+  return OK; }
+
+inline int FFTW_ExportWisdom(const char *FileName)                 // write to a temporary file first, so a crash does not leave a truncated file
+{ char TmpName[256]; snprintf(TmpName, 256, "%s.tmp", FileName);
+  char DoubleName[256]; snprintf(DoubleName, 256, "%s.double", FileName);
+  if(!fftwf_export_wisdom_to_filename(TmpName)) return 0;
+  if(rename(TmpName, FileName)<0) return 0;
+  snprintf(TmpName, 256, "%s.double.tmp", FileName);
+  if(fftw_export_wisdom_to_filename(TmpName)) rename(TmpName, DoubleName);
+  return 1; }
+
 // ===========================================================================================
 
 template <class Float>
@@ -39,20 +78,22 @@ template <class Float>
    fftw_plan            Plan;   // FFTW specific
    int                  Size;   // [FFT points]
    int                  Sign;   // forward or backward (inverse)
+   unsigned             Flags;  // planner flags the plan was made with
 
   public:
-   DFT1d() { Buffer=0; Plan=0; Size=0; Sign=0; }
+   DFT1d() { Buffer=0; Plan=0; Size=0; Sign=0; Flags=0; }
 
   ~DFT1d() { Free(); }
 
   void Free(void)
-   { if(Buffer) { fftw_destroy_plan(Plan); fftw_free(Buffer); Buffer=0; Size=0; Sign=0; } }
+   { if(Buffer) { fftw_destroy_plan(Plan); fftw_free(Buffer); Buffer=0; Size=0; Sign=0; Flags=0; } }
 
   int Preset(int Size, int Sign)
-  { if( (Size==this->Size) && (Sign==this->Sign) ) return Size;
+  { if( (Size==this->Size) && (Sign==this->Sign) && (Flags==FFTW_Flags()) ) return Size;
     Free();
     Buffer = (std::complex<Float> *)fftw_malloc(Size*sizeof(std::complex<Float>)); if(Buffer==0) return -1;
-    Plan = fftw_plan_dft_1d(Size, (fftw_complex *)Buffer, (fftw_complex *)Buffer, Sign, FFTW_MEASURE);
+    Flags = FFTW_Flags();
+    Plan = fftw_plan_dft_1d(Size, (fftw_complex *)Buffer, (fftw_complex *)Buffer, Sign, Flags);
     this->Size=Size; this->Sign=Sign; return Size; }
 
   int PresetForward(int Size) { return Preset(Size, FFTW_FORWARD); }
@@ -81,20 +122,22 @@ template <>
    fftwf_plan           Plan;
    int                  Size;
    int                  Sign;
+   unsigned             Flags;
 
   public:
-   DFT1d() { Buffer=0; Plan=0; Size=0; Sign=0; }
+   DFT1d() { Buffer=0; Plan=0; Size=0; Sign=0; Flags=0; }
 
   ~DFT1d() { Free(); }
 
   void Free(void)
-   { if(Buffer) { fftwf_destroy_plan(Plan); fftwf_free(Buffer); Buffer=0; Size=0; Sign=0; } }
+   { if(Buffer) { fftwf_destroy_plan(Plan); fftwf_free(Buffer); Buffer=0; Size=0; Sign=0; Flags=0; } }
 
   int Preset(int Size, int Sign)
-  { if( (Size==this->Size) && (Sign==this->Sign) ) return Size;
+  { if( (Size==this->Size) && (Sign==this->Sign) && (Flags==FFTW_Flags()) ) return Size;
     Free();
     Buffer = (std::complex<float> *)fftwf_malloc(Size*sizeof(std::complex<float>)); if(Buffer==0) return -1;
-    Plan = fftwf_plan_dft_1d(Size, (fftwf_complex *)Buffer, (fftwf_complex *)Buffer, Sign, FFTW_MEASURE);
+    Flags = FFTW_Flags();
+    Plan = fftwf_plan_dft_1d(Size, (fftwf_complex *)Buffer, (fftwf_complex *)Buffer, Sign, Flags);
     this->Size=Size; this->Sign=Sign; return Size; }
 
   int PresetForward(int Size) { return Preset(Size, FFTW_FORWARD); }
@@ -114,6 +157,107 @@ template <>
 
 } ;
 
+// ===========================================================================================
+// Batch of 1-D FFTs of the same size: Batch rows of Size points, transformed with one FFTW plan.
+// The plan is out-of-place: from Buffer to Output, but Execute() can write the spectra directly
+// into another array as long as it is aligned like Output (see isAligned()).
+
+template <class Float>
+ class DFT1dBatch
+{ public:
+   std::complex<Float> *Buffer; // input: Batch rows of Size points
+   std::complex<Float> *Output; // output: Batch rows of Size points
+   fftw_plan            Plan;   // FFTW specific
+   int                  Size;   // [FFT points]
+   int                  Batch;  // number of FFTs done at once
+   int                  Sign;   // forward or backward (inverse)
+   unsigned             Flags;  // planner flags the plan was made with
+
+  public:
+   DFT1dBatch() { Buffer=0; Output=0; Plan=0; Size=0; Batch=0; Sign=0; Flags=0; }
+
+  ~DFT1dBatch() { Free(); }
+
+  void Free(void)
+   { if(Plan) fftw_destroy_plan(Plan);
+     if(Buffer) fftw_free(Buffer);
+     if(Output) fftw_free(Output);
+     Buffer=0; Output=0; Plan=0; Size=0; Batch=0; Sign=0; Flags=0; }
+
+  int Preset(int Size, int Batch, int Sign)
+  { if( (Size==this->Size) && (Batch==this->Batch) && (Sign==this->Sign) && (Flags==FFTW_Flags()) ) return Size;
+    Free();
+    Buffer = (std::complex<Float> *)fftw_malloc(Batch*Size*sizeof(std::complex<Float>));
+    Output = (std::complex<Float> *)fftw_malloc(Batch*Size*sizeof(std::complex<Float>));
+    if( (Buffer==0) || (Output==0) ) { Free(); return -1; }
+    Plan = fftw_plan_many_dft(1, &Size, Batch, (fftw_complex *)Buffer, 0, 1, Size,
+                                              (fftw_complex *)Output, 0, 1, Size, Sign, FFTW_Flags());
+    if(Plan==0) { Free(); return -1; }
+    this->Size=Size; this->Batch=Batch; this->Sign=Sign; Flags=FFTW_Flags(); return Size; }
+
+  int PresetForward(int Size, int Batch) { return Preset(Size, Batch, FFTW_FORWARD); }
+  int PresetBackward(int Size, int Batch) { return Preset(Size, Batch, FFTW_BACKWARD); }
+
+  std::complex<Float> *Row(int Idx) { return Buffer+Idx*Size; }  // input row
+
+  int isAligned(std::complex<Float> *Out) const                   // can the output go directly here ?
+  { return fftw_alignment_of((Float *)Out)==fftw_alignment_of((Float *)Output); }
+
+  void Execute(void) { fftw_execute(Plan); }                      // from Buffer into Output
+  void Execute(std::complex<Float> *Out)                          // from Buffer into Out: Batch rows must fit there
+  { fftw_execute_dft(Plan, (fftw_complex *)Buffer, (fftw_complex *)Out); }
+
+} ;
+
+// ----------------------------------------------------------------------------------------------
+
+template <>
+ class DFT1dBatch <float>
+{ public:
+   std::complex<float> *Buffer;
+   std::complex<float> *Output;
+   fftwf_plan           Plan;
+   int                  Size;
+   int                  Batch;
+   int                  Sign;
+   unsigned             Flags;
+
+  public:
+   DFT1dBatch() { Buffer=0; Output=0; Plan=0; Size=0; Batch=0; Sign=0; Flags=0; }
+
+  ~DFT1dBatch() { Free(); }
+
+  void Free(void)
+   { if(Plan) fftwf_destroy_plan(Plan);
+     if(Buffer) fftwf_free(Buffer);
+     if(Output) fftwf_free(Output);
+     Buffer=0; Output=0; Plan=0; Size=0; Batch=0; Sign=0; Flags=0; }
+
+  int Preset(int Size, int Batch, int Sign)
+  { if( (Size==this->Size) && (Batch==this->Batch) && (Sign==this->Sign) && (Flags==FFTW_Flags()) ) return Size;
+    Free();
+    Buffer = (std::complex<float> *)fftwf_malloc(Batch*Size*sizeof(std::complex<float>));
+    Output = (std::complex<float> *)fftwf_malloc(Batch*Size*sizeof(std::complex<float>));
+    if( (Buffer==0) || (Output==0) ) { Free(); return -1; }
+    Plan = fftwf_plan_many_dft(1, &Size, Batch, (fftwf_complex *)Buffer, 0, 1, Size,
+                                               (fftwf_complex *)Output, 0, 1, Size, Sign, FFTW_Flags());
+    if(Plan==0) { Free(); return -1; }
+    this->Size=Size; this->Batch=Batch; this->Sign=Sign; Flags=FFTW_Flags(); return Size; }
+
+  int PresetForward(int Size, int Batch) { return Preset(Size, Batch, FFTW_FORWARD); }
+  int PresetBackward(int Size, int Batch) { return Preset(Size, Batch, FFTW_BACKWARD); }
+
+  std::complex<float> *Row(int Idx) { return Buffer+Idx*Size; }
+
+  int isAligned(std::complex<float> *Out) const
+  { return fftwf_alignment_of((float *)Out)==fftwf_alignment_of((float *)Output); }
+
+  void Execute(void) { fftwf_execute(Plan); }
+  void Execute(std::complex<float> *Out)
+  { fftwf_execute_dft(Plan, (fftwf_complex *)Buffer, (fftwf_complex *)Out); }
+
+} ;
+
 // ===========================================================================================
 
 template <class Float=double>
@@ -0,0 +1,127 @@
+#ifndef __FFTPOOL_H__
+#define __FFTPOOL_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+#include "buffer.h"
+
+// ==================================================================================================
+// Sliding FFT of a time slot split across a pool of worker threads: every worker has its own FFT plan
+// and window and takes the slides in chunks of Batch from a shared counter, thus the output is the same
+// as from the single-threaded SlidingFFT(). The thread which calls Process() works as one of the workers.
+
+template <class Float>
+ class SlidingFFT_Pool
+{ public:
+   int                 Workers;      // number of workers, including the calling thread
+   int                 Size;         // [FFT points]
+   int                 Batch;        // slides per FFT call and per chunk taken by a worker
+   const ThreadProfile *Profile;     // CPU and scheduling for the worker threads, can be null
+
+  private:
+   struct Worker
+   { SlidingFFT_Pool   *Pool;
+     int                Idx;
+     Thread             Thr;
+     DFT1dBatch<Float>  FFT;         // own FFT plan and buffers
+     Float             *Window;      // own copy of the window (with the half-swap built in)
+     Worker() { Pool=0; Idx=0; Window=0; }
+   } ;
+   Worker             *Work;
+   int                 Allocated;    // number of entries in Work[], can be more than the Workers which started
+
+   Condition           StartCond;    // workers wait here for a new job
+   Condition           DoneCond;     // Process() waits here for the workers to finish
+   uint32_t            Job;          // job counter: incremented for every new job
+   int                 Busy;         // number of workers still working on the current job
+   volatile int        StopReq;
+
+   SampleBuffer< std::complex<Float> > *Output;                     // the current job
+   const SampleBuffer<uint8_t>         *Input;
+   int                 Slides;
+   Float               InpBias;
+   int                 NextSlide;    // the next slide to be taken by a worker
+
+  public:
+   SlidingFFT_Pool() { Workers=0; Size=0; Batch=0; Profile=0; Work=0; Allocated=0; Job=0; Busy=0; StopReq=0; }
+  ~SlidingFFT_Pool() { Free(); }
+
+   void Free(void)
+   { if(Work==0) return;
+     StartCond.Lock(); StopReq=1; StartCond.Broadcast(); StartCond.Unlock();
+     for(int Idx=1; Idx<Workers; Idx++) Work[Idx].Thr.Join();
+     for(int Idx=0; Idx<Allocated; Idx++) free(Work[Idx].Window);
+     delete [] Work; Work=0; Allocated=0; Workers=0; StopReq=0; }
+
+   // Window = the (sine) window for SlidingFFT(), the half-swap is added here
+   int Preset(int Workers, int Size, int Batch, const Float *Window, const ThreadProfile *Profile=0)
+   { Free(); this->Profile=Profile;
+     if(Workers<1) Workers=1;
+     if(Batch<1) Batch=1;
+     Work = new (std::nothrow) Worker [Workers]; if(Work==0) return -1;
+     Allocated=Workers; this->Workers=Workers; this->Size=Size; this->Batch=Batch;
+     for(int Idx=0; Idx<Workers; Idx++)                             // the FFTW planner is not thread-safe: plan all here
+     { Worker &Wrk = Work[Idx]; Wrk.Pool=this; Wrk.Idx=Idx; Wrk.Window=0;
+       if(Wrk.FFT.PresetForward(Size, Batch)<0) { Free(); return -1; }
+       Wrk.Window = (Float *)malloc(Size*sizeof(Float)); if(Wrk.Window==0) { Free(); return -1; }
+       memcpy(Wrk.Window, Window, Size*sizeof(Float));
+       SwapHalfsWindow(Wrk.Window, Size); }
+     Job=0;
+     for(int Idx=1; Idx<Workers; Idx++)                             // worker #0 is the thread calling Process()
+     { Work[Idx].Thr.setExec(ThreadExec);
+       if(Work[Idx].Thr.Create(Work+Idx)!=0) { printf("SlidingFFT_Pool::Preset() ... cannot start worker #%d\n", Idx); Workers=Idx; break; }
+     }
+     this->Workers=Workers;
+     return Workers; }
+
+   // same as SlidingFFT() on a DFT1dBatch
+   int Process(SampleBuffer< std::complex<Float> > &Output, const SampleBuffer<uint8_t> &Input, Float InpBias=127.38)
+   { int WindowSize2=Size/2;
+     int InpSamples=Input.Full/2;
+     int Slides=SlidingFFT_Slides(InpSamples, Size);
+     Output.Allocate(Slides*Size); Output.Len=Size;
+     Output.Rate=Input.Rate/WindowSize2; Output.Time=Input.Time; Output.Date=Input.Date; Output.Freq=Input.Freq;
+     StartCond.Lock();                                              // setup the job and wake up the workers
+     this->Output=&Output; this->Input=&Input; this->Slides=Slides; this->InpBias=InpBias;
+     __atomic_store_n(&NextSlide, 0, __ATOMIC_RELAXED);
+     DoneCond.Lock(); Busy=Workers-1; DoneCond.Unlock();
+     Job++; StartCond.Broadcast(); StartCond.Unlock();
+     ProcessChunks(Work[0]);                                        // this thread works as well
+     DoneCond.Lock();
+     while(Busy>0) DoneCond.Wait();                                 // wait for the other workers
+     DoneCond.Unlock();
+     Output.Full=Slides*Size;
+     return Slides; }
+
+  private:
+   void ProcessChunks(Worker &Wrk)                                  // take chunks of slides until all done
+   { for( ; ; )
+     { int First=__atomic_fetch_add(&NextSlide, Batch, __ATOMIC_RELAXED);
+       if(First>=Slides) break;
+       int Last=First+Batch; if(Last>Slides) Last=Slides;
+       SlidingFFT_Range(*Output, *Input, Wrk.FFT, Wrk.Window, First, Last, Slides, InpBias); }
+   }
+
+   static void *ThreadExec(void *Context)
+   { Worker *Wrk = (Worker *)Context; return Wrk->Pool->Exec(*Wrk); }
+
+   void *Exec(Worker &Wrk)
+   { uint32_t DoneJob=0;                                            // Preset() sets Job to zero before starting the workers
+     if(Profile) Profile->Apply();
+     for( ; ; )
+     { StartCond.Lock();
+       while( (Job==DoneJob) && !StopReq ) StartCond.Wait();      // wait for a new job
+       DoneJob=Job; int Stop=StopReq;
+       StartCond.Unlock();
+       if(Stop) break;
+       ProcessChunks(Wrk);
+       DoneCond.Lock(); Busy--; if(Busy==0) DoneCond.Signal(); DoneCond.Unlock(); }
+     return 0; }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __FFTPOOL_H__
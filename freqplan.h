@@ -2,6 +2,7 @@
 #define __FREQPLAN_H__
 
 #include <stdint.h>
+#include <algorithm>
 
 class FreqPlan
 { public:
@@ -50,6 +51,27 @@ class FreqPlan
    uint32_t getFrequency(uint32_t Time, uint8_t Slot=0, uint8_t OGN=1) const
    { uint8_t Channel=getChannel(Time, Slot, OGN); return BaseFreq+ChanSepar*Channel; } // return frequency [Hz] for given UTC time and slot
 
+   int getActiveFrequencies(uint32_t *Freq, uint32_t Time) const   // FLARM and OGN frequencies of both slots of the second, sorted, without repeats
+   { Freq[0] = getFrequency(Time, 0, 0);                                  // Freq[] must hold 4: returns how many are set
+     Freq[1] = getFrequency(Time, 0, 1);
+     Freq[2] = getFrequency(Time, 1, 0);
+     Freq[3] = getFrequency(Time, 1, 1);
+     std::sort(Freq, Freq+4);
+     return std::unique(Freq, Freq+4)-Freq; }
+
+   uint32_t getCenterFrequency(uint32_t Time, uint32_t Band) const // center frequency for a receiver of given bandwidth to cover as many OGN and FLARM hops as possible
+   { uint32_t HopFreq[4];
+     HopFreq[0] = getFrequency(Time, 0, 0);
+     HopFreq[1] = getFrequency(Time, 0, 1);
+     HopFreq[2] = getFrequency(Time, 1, 0);
+     HopFreq[3] = getFrequency(Time, 1, 1);
+     uint32_t CenterFreq = (HopFreq[0]+HopFreq[1]+1)>>1;              // by default: center between FLARM and OGN in the 1st slot
+     std::sort(HopFreq, HopFreq+4);
+     if((HopFreq[3]-HopFreq[0])<Band) CenterFreq=(HopFreq[0]+HopFreq[3]+1)>>1;
+     else if((HopFreq[2]-HopFreq[0])<Band) CenterFreq=(HopFreq[0]+HopFreq[2]+1)>>1;
+     else if((HopFreq[3]-HopFreq[1])<Band) CenterFreq=(HopFreq[1]+HopFreq[3]+1)>>1;
+     return CenterFreq; }
+
    uint8_t static calcPlan(int32_t Latitude, int32_t Longitude) // get the frequency plan from Lat/Lon: 1 = Europe + Africa, 2 = USA/CAnada, 3 = Australia + South America, 4$
    { if( (Longitude>=(-20*600000)) && (Longitude<=(60*600000)) ) return 1; // between -20 and 60 deg Lat => Europe + Africa: 868MHz band
      if( Latitude<(20*600000) )                                            // below 20deg latitude
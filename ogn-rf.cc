@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <libconfig.h>
 
@@ -33,6 +34,12 @@
 #include "thread.h"     // multi-thread stuff
 #include "fft.h"        // Fast Fourier Transform
 #include "rtlsdr.h"     // SDR radio
+#include "samplering.h" // lock-free ring for the streaming acquisition
+#include "samplesource.h" // time slots from a file instead of the SDR
+#include "fftpool.h"    // sliding FFT across several threads
+#include "rawwriter.h"  // large aligned writes for the raw data recorder
+#include "rawarchive.h" // index of the raw data files
+#include "stagestats.h" // CPU and latency statistics of the processing stages
 
 #define QUOTE(name) #name
 #define STR(macro) QUOTE(macro)
@@ -50,6 +57,9 @@
 #include "tonefilter.h"
 
 #include "dataserver.h"
+#include "shmring.h"
+#include "sparsespectra.h"
+#include "chanspectra.h"
 
 // ==================================================================================================
 
@@ -73,6 +83,64 @@ template <class Float> // scale floating-point data to 8-bit gray scale image
 
 // ==================================================================================================
 
+template <class Queue> // read <Path>.Depth, <Path>.Policy and <Path>.HighWater of an object queue
+ void Config_Queue(config_t *Config, const char *Path, Queue &Q)
+{ char Name[64]; QueueControl &Ctrl = Q.Ctrl;
+  sprintf(Name, "%s.Depth", Path);     config_lookup_int(Config, Name, &Ctrl.Depth);
+  sprintf(Name, "%s.HighWater", Path); config_lookup_int(Config, Name, &Ctrl.HighWater);
+  const char *Policy=0;
+  sprintf(Name, "%s.Policy", Path);    config_lookup_string(Config, Name, &Policy);
+  if(Policy)
+  { int Value=QueueControl::getPolicy(Policy);
+    if(Value>=0) Ctrl.Policy=Value;
+            else printf("Config_Queue() ... %s: unknown policy \"%s\"\n", Name, Policy); }
+  int MaxDepth=Q.Capacity()/2;                                      // room for DropOldest to overshoot
+  if(Ctrl.Depth<1) Ctrl.Depth=1; else if(Ctrl.Depth>MaxDepth) Ctrl.Depth=MaxDepth;
+  if(Ctrl.HighWater<1) Ctrl.HighWater=1; }
+
+// read <Path>.CPU (like "2,3" or "1-3"), <Path>.Policy (other, fifo, rr, batch, idle), <Path>.Priority and <Path>.StackPrefault [KB]
+inline void Config_Thread(config_t *Config, const char *Path, ThreadProfile &Profile)
+{ char Name[64];
+  const char *CPUs=0; int CPU;
+  sprintf(Name, "%s.CPU", Path);
+  if(config_lookup_int(Config, Name, &CPU)==CONFIG_TRUE) { if( (CPU>=0) && (CPU<64) ) Profile.CPUs=(uint64_t)1<<CPU; }
+  else if(config_lookup_string(Config, Name, &CPUs)==CONFIG_TRUE)
+  { if(Profile.setCPUs(CPUs)<0) printf("Config_Thread() ... %s: cannot read \"%s\"\n", Name, CPUs); }
+  const char *Policy=0;
+  sprintf(Name, "%s.Policy", Path);        config_lookup_string(Config, Name, &Policy);
+  if(Policy && (Profile.setPolicy(Policy)<0) ) printf("Config_Thread() ... %s: unknown policy \"%s\"\n", Name, Policy);
+  sprintf(Name, "%s.Priority", Path);      config_lookup_int(Config, Name, &Profile.Priority);
+  sprintf(Name, "%s.StackPrefault", Path); config_lookup_int(Config, Name, &Profile.StackPrefault); }
+
+template <class Queue> // one row of queue statistics for the status page
+ void Status_Queue(int File, const char *Name, Queue &Q)
+{ const QueueControl &Ctrl = Q.Ctrl;
+  dprintf(File, "<tr><td>Queue %s: %d/%d, %s</td><td align=right><b>%d in, %d dropped, %d recycled, %d peak",
+          Name, Q.Size(), Ctrl.Depth, QueueControl::PolicyName(Ctrl.Policy), Ctrl.Enqueued, Ctrl.Dropped, Ctrl.Recycled, Ctrl.MaxSize);
+  if(Ctrl.Blocked) dprintf(File, ", %d blocked", Ctrl.Blocked);
+  dprintf(File, "</b></td></tr>\n"); }
+
+inline void Status_Thread(int File, const char *Name, const ThreadProfile &Profile) // one row: scheduling and CPUs of a thread
+{ char Line[128]; Profile.Print(Line);
+  dprintf(File, "<tr><td>Thread %s</td><td align=right><b>%s</b></td></tr>\n", Name, Line); }
+
+inline void Status_Stage(int File, const char *Name, StageStats &Stats) // one row of stage statistics for the status page
+{ if(Stats.getCount()==0) return;
+  dprintf(File, "<tr><td>Stage %s [ms] mean/p50/p99/max</td><td align=right><b>", Name);
+  for(int Value=0; Value<StageStats::Values; Value++)
+  { char Line[64]; Stats.Print(Line, Value);
+    dprintf(File, "%s%s %s", Value ? "<br />":"", StageStats::Name(Value), Line); }
+  dprintf(File, "</b></td></tr>\n"); }
+
+inline void Print_Stage(const char *Name, StageStats &Stats)          // the same for the stdin command output
+{ if(Stats.getCount()==0) return;
+  printf("Stage %-6s [ms] mean/p50/p99/max:", Name);
+  for(int Value=0; Value<StageStats::Values; Value++)
+  { char Line[64]; Stats.Print(Line, Value); printf(" %s %s", StageStats::Name(Value), Line); }
+  printf("\n"); }
+
+// ==================================================================================================
+
 class RF_Acq                                    // acquire wideband (1MHz) RF data thus both OGN frequencies at same time
 { public:
    int    SampleRate;                           // [Hz] sampling rate
@@ -91,11 +159,30 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
    int  FreqCorr;                               // [ppm] frequency correction applied to the Rx chip
    int  FreqRaster;                             // [Hz] use only center frequencies on this raster to avoid tuning inaccuracies
    RTLSDR SDR;                                  // SDR receiver (DVB-T stick)
-   ReuseObjectQueue< SampleBuffer<uint8_t> > OutQueue; // OGN sample batches are sent there
+   SPSC_ReuseObjectQueue< SampleBuffer<uint8_t> > OutQueue; // OGN sample batches are sent there (lock-free: this thread must not wait on a consumer)
 
    Thread Thr;                                  // acquisition thread
+   ThreadProfile Profile;                       // CPU and scheduling of the acquisition thread
    volatile int StopReq;                        // request to stop the acquisition thread
 
+   int          Streaming;                      // [bool] continuous acquisition with ReadAsync() instead of ResetBuffer()+Read() per slot
+   SampleRing   Ring;                           // streaming: the USB callback writes here, time slots are cut out of it
+   Thread       AsyncThr;                       // streaming: thread running the (blocking) SDR.ReadAsync()
+   ThreadProfile AsyncProfile;                  // streaming: CPU and scheduling of the ReadAsync() thread
+   volatile int AsyncDone;                      // streaming: ReadAsync() has returned
+   static const int StreamBuffers   = 12;       // streaming: number of USB buffers
+   static const int StreamBlockSize = 65536;    // [bytes] streaming: USB buffer size, 32ms at 1Msps
+
+   SampleSource *Source;                        // when set, time slots are taken from here instead of the SDR
+   int           Synthetic;                     // [bool] take time slots from the SyntheticSource (RF.Synth.*)
+   char          ReplayFile[256];               // raw data file (as written with RF.OGN.SaveRawData) to replay
+   double        ReplaySpeed;                   // 1.0 = real time, 0 = as fast as possible (but do not drop slots)
+   int           ReplayLoop;                    // [bool] start over at the end of the file
+   double        ReplayStart;                   // [sec] start the replay at the first slot at or after this (UTC) time, through the index
+   int           SourceSlots;                   // number of slots taken from the Source
+   double        SourceRate;                    // [slots/sec] average rate of slots taken from the Source
+   uint32_t      SourcePulses;                  // number of pulses removed by the PulseFilter from the Source slots
+
    PulseFilter PulseFilt;
 
    static const int GSM_GainMode = 1;           // Manual gain mode for GSM
@@ -107,21 +194,24 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
    static const int GSM_LowEdge = 925100000;    // [Hz] E-GSM-900 band, excluding the guards of 100kHz
    static const int GSM_UppEdge = 959900000;    // [Hz]
    static const int GSM_ScanStep =   800000;    // [Hz]
-   ReuseObjectQueue< SampleBuffer<uint8_t> > GSM_OutQueue; // GSM sample batches are sent there
+   SPSC_ReuseObjectQueue< SampleBuffer<uint8_t> > GSM_OutQueue; // GSM sample batches are sent there
 
    const static uint32_t   OGN_RawDataSync = 0x254F7D01;
 
    char                    FilePrefix[16];
    int                     OGN_SaveRawData;
+   SPSC_ReuseObjectQueue< SampleBuffer<uint8_t> > RecordQueue; // copies of the time slots to be written by the RF_Recorder
+
+   MemoryPool              SlotPool;                   // storage for the raw time slots, allocated before the threads start
+   int                     PoolEnable;                 // [bool]
+   int                     PoolHugePages;              // [bool] back the pool by huge pages
+   int                     PoolPrefault;               // [bool] touch all the pool memory at start
    MessageQueue<Socket *>  RawDataQueue;               // sockets send to this queue should be written with a most recent raw data
    MessageQueue<Socket *>  SpectrogramQueue;           // sockets send to this queue should be written with a most recent spectrogram
-   DFT1d<float>            SpectrogramFFT;             // FFT to create spectrograms
-   int                     SpectrogramFFTsize;
-   float                  *SpectrogramWindow;
-   SampleBuffer< std::complex<float> > SpectraBuffer;
-   SampleBuffer<float>     SpectraPwr;
-   SampleBuffer<uint8_t>   Image;
-   JPEG                    JpegImage;
+   typedef MessageQueue< RefSampleBuffer<uint8_t> * > SnapshotReceiver;
+   RefSampleBufferSet<uint8_t> SnapshotSet;     // snapshot buffers for reuse, thus the acquisition does not allocate them (after SlotPool: destroyed before it)
+   MessageQueue<SnapshotReceiver *> SnapshotQueue;     // other threads wanting a copy of the next time slot put their receiving queue here
+   volatile double         LastSlotTime;               // [sec] time of the most recent OGN time slot
 
    time_t                  StartTime;
    uint32_t                CountAllTimeSlots;
@@ -131,11 +221,13 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
    RF_Acq() { Config_Defaults();
               GSM_FreqCorr=0;
               // PulseBox.Preset(PulseBoxSize);
-              SpectrogramWindow=0;
+              LastSlotTime=0;
               StartTime=0; CountAllTimeSlots=0; CountLifeTimeSlots=0;
-              StopReq=0; Thr.setExec(ThreadExec); }
+              StopReq=0; Thr.setExec(ThreadExec);
+              AsyncDone=1; AsyncThr.setExec(AsyncExec);
+              Source=0; SourceSlots=0; SourceRate=0; SourcePulses=0; }
 
-  ~RF_Acq() { if(SpectrogramWindow) free(SpectrogramWindow); }
+  ~RF_Acq() { delete Source; }
 
   double getLifeTime(void)
   { time_t Now; time(&Now); if(Now<=StartTime) return 0;
@@ -151,8 +243,14 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
     OffsetTuning=0; FreqCorr=0; FreqRaster=28125; BiasTee=(-1);
     // GSM_CenterFreq=GSM_LowEdge+GSM_ScanStep/2; GSM_Scan=1; GSM_SamplesPerRead=(250*SampleRate)/1000; GSM_Gain=200;
     GSM_CenterFreq=0; GSM_Scan=0; GSM_Gain=200;
-    SpectrogramFFTsize=0;
     OGN_SaveRawData=0;
+    OutQueue.Ctrl.Depth=4; OutQueue.Ctrl.HighWater=2;           // from two slots waiting on, only half slots are read
+    GSM_OutQueue.Ctrl.Depth=3;
+    RecordQueue.Ctrl.Depth=8;
+    PoolEnable=1; PoolHugePages=0; PoolPrefault=1;
+    Profile = ThreadProfile(SCHED_FIFO, -1); AsyncProfile = ThreadProfile(SCHED_FIFO, -1); // the highest real-time priority
+    Streaming=0;
+    ReplayFile[0]=0; ReplaySpeed=1.0; ReplayLoop=0; ReplayStart=0; Synthetic=0;
     FilePrefix[0]=0; }
 
   int config_lookup_float_or_int(config_t *Config, const char *Path, double *Value)
@@ -160,6 +258,26 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
     int IntValue; Ret = config_lookup_int(Config, Path, &IntValue); if(Ret==CONFIG_TRUE) { (*Value) = IntValue; return Ret; }
     return Ret; }
 
+  SampleSource *ConfigSynth(config_t *Config)                               // synthetic time slots, with the same timing and tuning as the SDR
+  { SyntheticSource *Synth = new SyntheticSource;
+    Synth->SampleRate=SampleRate; Synth->SlotSamples=OGN_SamplesPerRead; Synth->SlotStart=OGN_StartTime;
+    Synth->GSM_Samples=GSM_SamplesPerRead; Synth->GSM_CenterFreq=GSM_CenterFreq;
+    Synth->Plan=HoppingPlan; Synth->Band=SampleRate-150000;
+    double Value;
+    Value=0; config_lookup_float_or_int(Config, "RF.Synth.StartTime",   &Value); Synth->StartTime=(uint32_t)Value;
+    Value=Synth->FreqError;    config_lookup_float_or_int(Config, "RF.Synth.FreqError",    &Value); Synth->FreqError=Value;
+    Value=Synth->NoiseLevel;   config_lookup_float_or_int(Config, "RF.Synth.Noise",        &Value); Synth->NoiseLevel=Value;
+    Value=Synth->BurstRate;    config_lookup_float_or_int(Config, "RF.Synth.Bursts",       &Value); Synth->BurstRate=Value;
+    Value=Synth->BurstSNR;     config_lookup_float_or_int(Config, "RF.Synth.BurstSNR",     &Value); Synth->BurstSNR=Value;
+    Value=Synth->PulseRate;    config_lookup_float_or_int(Config, "RF.Synth.Pulses",       &Value); Synth->PulseRate=Value;
+    Value=Synth->PulseSNR;     config_lookup_float_or_int(Config, "RF.Synth.PulseSNR",     &Value); Synth->PulseSNR=Value;
+    Value=Synth->GSM_SNR;      config_lookup_float_or_int(Config, "RF.Synth.GSM_SNR",      &Value); Synth->GSM_SNR=Value;
+    Value=Synth->CW_SNR;       config_lookup_float_or_int(Config, "RF.Synth.CW_SNR",       &Value); Synth->CW_SNR=Value;
+    config_lookup_int(Config, "RF.Synth.GSM_Carriers", &Synth->GSM_Carriers);
+    config_lookup_int(Config, "RF.Synth.CW_Carriers",  &Synth->CW_Carriers);
+    int Seed=Synth->Seed; config_lookup_int(Config, "RF.Synth.Seed", &Seed); Synth->Seed=Seed;
+    return Synth; }
+
   int Config(config_t *Config)
   { const char *Call=0;
     config_lookup_string(Config,"APRS.Call", &Call);
@@ -177,6 +295,24 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
     config_lookup_int(Config,   "RF.OGN.GainMode",   &OGN_GainMode);
 
     config_lookup_int(Config,   "RF.OGN.SaveRawData",   &OGN_SaveRawData);
+    config_lookup_int(Config,   "RF.Streaming",         &Streaming);
+
+    Config_Queue(Config, "RF.Queue.OGN",    OutQueue);
+    Config_Queue(Config, "RF.Queue.GSM",    GSM_OutQueue);
+    Config_Queue(Config, "RF.Queue.Record", RecordQueue);
+    config_lookup_int(Config,   "RF.Pool.Enable",       &PoolEnable);
+    config_lookup_int(Config,   "RF.Pool.HugePages",    &PoolHugePages);
+    config_lookup_int(Config,   "RF.Pool.Prefault",     &PoolPrefault);
+    Config_Thread(Config, "RF.Threads.Acq",   Profile);
+    Config_Thread(Config, "RF.Threads.Async", AsyncProfile);
+
+    const char *Replay = 0;
+    config_lookup_string(Config,"RF.Replay.File",       &Replay);
+    if(Replay) { strncpy(ReplayFile, Replay, 256); ReplayFile[255]=0; }
+    config_lookup_float_or_int(Config, "RF.Replay.Speed", &ReplaySpeed);
+    config_lookup_int(Config,   "RF.Replay.Loop",       &ReplayLoop);
+    config_lookup_float_or_int(Config, "RF.Replay.Start", &ReplayStart);
+    config_lookup_int(Config,   "RF.Synth.Enable",      &Synthetic);
 
     SampleRate=1000000;
     if(config_lookup_int(Config, "RF.OGN.SampleRate", &SampleRate)!=CONFIG_TRUE)
@@ -212,6 +348,7 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
 
     PulseFilt.Threshold=0;
     config_lookup_int(Config, "RF.PulseFilter.Threshold",  &PulseFilt.Threshold);
+    config_lookup_int(Config, "RF.PulseFilter.Stats",      &PulseFilt.StatsEnable);
 
     config_lookup_float(Config, "RF.OGN.StartTime", &OGN_StartTime);
     double SensTime=0.850;
@@ -221,13 +358,37 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
     config_lookup_float(Config, "RF.GSM.SensTime",  &SensTime);
     GSM_SamplesPerRead=(int)floor(SensTime*SampleRate+0.5);
 
-    SpectrogramFFTsize=(8*SampleRate)/15625;
-    SpectrogramFFT.PresetForward(SpectrogramFFTsize);
-    SpectrogramWindow=(float *)realloc(SpectrogramWindow, SpectrogramFFTsize*sizeof(float));
-    SpectrogramFFT.SetSineWindow(SpectrogramWindow, SpectrogramFFTsize, (float)(1.0/sqrt(SpectrogramFFTsize)) );
+    delete Source; Source=0;
+    if(ReplayFile[0]) { RawFileSource *Replay = new RawFileSource(ReplayFile, OGN_RawDataSync, ReplayLoop); Replay->StartTime=ReplayStart; Source=Replay; }
+    else if(Synthetic) Source = ConfigSynth(Config);
 
     return 0; }
 
+   // preallocate the time slot buffers for the queues, thus the acquisition does not allocate memory
+   int PresetBuffers(void)
+   { if(!PoolEnable) return 0;
+     int OGN_Count = OutQueue.Ctrl.Depth+2;                                // waiting + being processed + being filled
+     if(OutQueue.Ctrl.Policy==QueueControl::DropOldest) OGN_Count+=OutQueue.Ctrl.Depth;
+     int GSM_Count = GSM_CenterFreq>0 ? GSM_OutQueue.Ctrl.Depth+2:0;
+     int Record_Count = RecordQueue.Ctrl.Depth+1;                         // recording can be started later by a command on stdin
+     int Snapshot_Count = 2;                                               // one being used by the spectrogram or raw data client, one being filled
+     int Count = OGN_Count+GSM_Count+Record_Count+Snapshot_Count;
+     size_t Bytes = 2*(size_t)std::max(OGN_SamplesPerRead, GSM_SamplesPerRead); // complex 8-bit samples
+     if(SlotPool.Preset(Count, Bytes, PoolHugePages, PoolPrefault)<0)
+     { printf("RF_Acq.PresetBuffers() ... cannot allocate %d x %d bytes\n", Count, (int)Bytes); return -1; }
+     for(int Idx=0; Idx<OGN_Count; Idx++)    OutQueue.Reserve(NewSlot(Bytes));
+     for(int Idx=0; Idx<GSM_Count; Idx++)    GSM_OutQueue.Reserve(NewSlot(Bytes));
+     for(int Idx=0; Idx<Record_Count; Idx++) RecordQueue.Reserve(NewSlot(Bytes));
+     for(int Idx=0; Idx<Snapshot_Count; Idx++)
+     { RefSampleBuffer<uint8_t> *Snapshot = new RefSampleBuffer<uint8_t>;
+       Snapshot->Pool=&SlotPool; Snapshot->Allocate(Bytes); SnapshotSet.Put(Snapshot); }
+     printf("RF_Acq.PresetBuffers() ... %d x %3.1f MB%s\n", SlotPool.Blocks, 1e-6*SlotPool.BlockSize, SlotPool.HugePages ? " on huge pages":"");
+     return SlotPool.Blocks; }
+
+   SampleBuffer<uint8_t> *NewSlot(size_t Bytes)
+   { SampleBuffer<uint8_t> *Slot = new SampleBuffer<uint8_t>;
+     Slot->Pool=&SlotPool; Slot->Allocate(Bytes); return Slot; }
+
    int QueueSize(void) { return OutQueue.Size(); }
 
    int Start(void) { StopReq=0; return Thr.Create(this); }
@@ -239,8 +400,9 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
    void *Exec(void)
    { // printf("RF_Acq.Exec() ... Start\n");
      time(&StartTime); CountAllTimeSlots=0; CountLifeTimeSlots=0;
-     char Header[256];
-     int Priority = Thr.getMaxPriority(); Thr.setPriority(Priority);
+     Profile.Apply();
+     if(Source) return ExecSource();
+     if(Streaming) return ExecStream();
      int CurrCenterFreq = calcCenterFreq(0);
      while(!StopReq)
      { if(SDR.isOpen())                                                    // if device is already open
@@ -254,73 +416,25 @@ class RF_Acq                                    // acquire wideband (1MHz) RF da
          double WaitTime = OGN_StartTime-FracTimeNow; if(WaitTime<0) WaitTime+=1.0;
          int SamplesToRead=OGN_SamplesPerRead;
          int LifeSlots=2;
-         if( ReadGSM || (QueueSize()>1) ) { SamplesToRead/=2; LifeSlots=1; }  // when GSM calibration or data is not being processed fast enough we only read half-time
+         if( ReadGSM || (QueueSize()>=OutQueue.Ctrl.HighWater) ) { SamplesToRead/=2; LifeSlots=1; }  // when GSM calibration or data is not being processed fast enough we only read half-time
          if(WaitTime<0.200)
          { usleep((int)floor(1e6*WaitTime+0.5));                              // wait right before the time slot starts
            SampleBuffer<uint8_t> *Buffer = OutQueue.New();                    // get the next buffer to fill with raw I/Q data
            SDR.ResetBuffer();                                                 // needed before every Read()
            int Read=SDR.Read(*Buffer, SamplesToRead);                         // read the time slot raw RF data
            if(Read>0) // RF data Read() successful
-           { Buffer->Freq += Buffer->Freq * (1e-6*GSM_FreqCorr);                 // correct the frequency (sign ?)
-             if(OGN_SaveRawData>0)
-             { time_t Time=(time_t)floor(Buffer->Time);
-               struct tm *TM = gmtime(&Time);
-               char FileName[32]; sprintf(FileName, "%s_%04d.%02d.%02d.u8", FilePrefix, 1900+TM->tm_year, TM->tm_mon+1, TM->tm_mday);
-               FILE *File=fopen(FileName, "ab");
-               if(File)
-               { Serialize_WriteSync(File, OGN_RawDataSync);
-                 Buffer->Serialize(File);
-                 fclose(File);
-                 OGN_SaveRawData--; }
-             }
-             PulseFilt.Process(*Buffer);
-             if(QueueSize()>1) printf("RF_Acq.Exec() ... Half time slot\n");
-             // printf("RF_Acq.Exec() ... SDR.Read() => %d, Time=%16.3f, Freq=%6.1fMHz\n", Read, Buffer->Time, 1e-6*Buffer->Freq);
-             while(RawDataQueue.Size())                                       // when a raw data for this slot was requested
-             { Socket *Client; RawDataQueue.Pop(Client);
-               sprintf(Header, "HTTP/1.1 200 OK\r\nCache-Control: no-cache\r\nContent-Type: audio/basic\r\n\
-Content-Disposition: attachment; filename=\"%s_%07.3fMHz_%03.1fMsps_%14.3fsec.u8\"\r\n\r\n", FilePrefix, 1e-6*Buffer->Freq, 1e-6*Buffer->Rate, Buffer->Time);
-               Client->Send(Header);
-               Client->Send(Buffer->Data, Buffer->Full);
-               Client->SendShutdown(); Client->Close(); delete Client; }
-             if(SpectrogramQueue.Size())
-             { SlidingFFT(SpectraBuffer, *Buffer, SpectrogramFFT, SpectrogramWindow);
-               SpectraPower(SpectraPwr, SpectraBuffer);                                         // calc. spectra power
-               float BkgNoise=0.33;
-               LogImage(Image, SpectraPwr, (float)BkgNoise, (float)32.0, (float)32.0);  // make the image
-               JpegImage.Compress_MONO8(Image.Data, Image.Len, Image.Samples() ); }         // and into JPEG
-             while(SpectrogramQueue.Size())
-             { Socket *Client; SpectrogramQueue.Pop(Client);
-               sprintf(Header, "HTTP/1.1 200 OK\r\nCache-Control: no-cache\r\nContent-Type: image/jpeg\r\nRefresh: 5\r\n\
-Content-Disposition: attachment; filename=\"%s_%07.3fMHz_%03.1fMsps_%10dsec.jpg\"\r\n\r\n",
-                        FilePrefix, 1e-6*SpectraBuffer.Freq, 1e-6*SpectraBuffer.Rate*SpectraBuffer.Len/2, (uint32_t)floor(SpectraBuffer.Date+SpectraBuffer.Time));
-               Client->Send(Header);
-               Client->Send(JpegImage.Data, JpegImage.Size);
-               Client->SendShutdown(); Client->Close(); delete Client; }
-             if(OutQueue.Size()<4) { OutQueue.Push(Buffer); CountLifeTimeSlots+=LifeSlots; }
-                              else { OutQueue.Recycle(Buffer); printf("RF_Acq.Exec() ... Dropped a slot\n"); }
-           } else     // RF data Read() failed
-           { SDR.Close(); printf("RF_Acq.Exec() ... SDR.Read() failed => SDR.Close()\n"); continue; }
+           { ProcessSlot(Buffer, LifeSlots); }
+           else     // RF data Read() failed
+           { OutQueue.Drop(Buffer); SDR.Close(); printf("RF_Acq.Exec() ... SDR.Read() failed => SDR.Close()\n"); continue; }
            if(ReadGSM) // if we are to read GSM in the second half-slot
-           { SDR.setCenterFreq(GSM_CenterFreq);      // setup for the GSM reception
-             SDR.setTunerGainMode(GSM_GainMode);
-             SDR.setTunerGain(GSM_Gain);
-             GSM_FreqCorr-=(FreqCorr-SDR.getFreqCorrection()); // this is just in case someone changed the frequency correction live
-             SDR.setFreqCorrection(FreqCorr);
+           { setTuneGSM();                              // setup for the GSM reception
              SampleBuffer<uint8_t> *Buffer = GSM_OutQueue.New();
              SDR.ResetBuffer();
              int Read=SDR.Read(*Buffer, GSM_SamplesPerRead);
              // printf("RF_Acq.Exec() ...(GSM) SDR.Read() => %d, Time=%16.3f, Freq=%6.1fMHz\n", Read, Buffer->Time, 1e-6*Buffer->Freq);
-             if(Read>0)
-             { if(GSM_OutQueue.Size()<3) GSM_OutQueue.Push(Buffer);
-                                  else { GSM_OutQueue.Recycle(Buffer); printf("RF_Acq.Exec() ... Dropped a GSM batch\n"); }
-             }
-             SDR.setTunerGainMode(OGN_GainMode);
-             SDR.setTunerGain(OGN_Gain);                // back to OGN reception setup
-             if(GSM_Scan)
-             { GSM_CenterFreq+=GSM_ScanStep;
-               if(GSM_CenterFreq>=GSM_UppEdge) GSM_CenterFreq=GSM_LowEdge+GSM_ScanStep/2;
-             }
+             if(Read>0) ProcessGSM(Buffer);
+                   else GSM_OutQueue.Drop(Buffer);
+             setTuneOGN();                              // back to OGN reception setup
            }
            // if(ReadGSM | OGN_FreqHopChannels)
            { SDR.setCenterFreq(NextCenterFreq); CurrCenterFreq=NextCenterFreq; }
@@ -328,46 +442,411 @@ Content-Disposition: attachment; filename=\"%s_%07.3fMHz_%03.1fMsps_%10dsec.jpg\
          else usleep(100000);
        }
        else                                                                // if not open yet or was closed due to an error
-       { int Index=(-1);
-         if(DeviceSerial[0]) Index=SDR.getDeviceIndexBySerial(DeviceSerial);
-         if(Index<0) Index=DeviceIndex;
-         SDR.FreqRaster = FreqRaster;
-         if(SDR.Open(Index, CurrCenterFreq, SampleRate)<0)                    // try to open it
-         { printf("RF_Acq.Exec() ... SDR.Open(%d, , ) fails, retry after 1 sec\n", Index); usleep(1000000); }
-         else
-         { SDR.setOffsetTuning(OffsetTuning);
-           if(BiasTee>=0) SDR.setBiasTee(BiasTee);
-           SDR.setTunerGainMode(OGN_GainMode);
-           SDR.setTunerGain(OGN_Gain);
-           SDR.setFreqCorrection(FreqCorr); }
-       }
+       { if(OpenSDR(CurrCenterFreq)<0) usleep(1000000); }
      }
 
      SDR.Close();
      // printf("RF_Acq.Exec() ... Stop\n");
      return  0; }
 
+   // streaming acquisition: the SDR runs continuously with ReadAsync() into the Ring and the time slots
+   // are cut out of the Ring at sample counts derived from the sample clock, thus there is no USB restart
+   // per slot and no dependence on when exactly this thread wakes up.
+   void *ExecStream(void)
+   { int CurrCenterFreq = calcCenterFreq(0);
+     uint32_t SlotIdx=0; int SlotIdxValid=0;                              // [samples] where the previous OGN slot started
+     int SlotSec=0;                                                        // [sec] the time slot to be acquired next
+     uint32_t LastBlocks=0; double LastBlockTime=0;                        // to watch if the data keeps coming
+     while(!StopReq)
+     { if(!SDR.isOpen())
+       { if(OpenSDR(CurrCenterFreq)<0) { usleep(1000000); continue; }
+         if(Ring.Preset(4*SampleRate)<0) { printf("RF_Acq.Exec() ... cannot allocate the sample ring\n"); SDR.Close(); usleep(1000000); continue; }
+         AsyncDone=0;
+         if(AsyncThr.Create(this)<0) { printf("RF_Acq.Exec() ... cannot start the ReadAsync() thread\n"); AsyncDone=1; SDR.Close(); usleep(1000000); continue; }
+         SlotIdxValid=0; LastBlocks=0; LastBlockTime=SDR.getTime();
+         SlotSec=(int)floor(LastBlockTime)+1;
+         CurrCenterFreq=calcCenterFreq(SlotSec); SDR.setCenterFreq(CurrCenterFreq);
+         printf("RF_Acq.Exec() ... streaming %d samples/sec into a %d-sample ring\n", SampleRate, Ring.Size); }
+
+       double Now = SDR.getTime();
+       uint32_t Blocks=Ring.getBlocks();
+       if(Blocks!=LastBlocks) { LastBlocks=Blocks; LastBlockTime=Now; }
+       if( AsyncDone || ((Now-LastBlockTime)>2.0) )                         // ReadAsync() ended or the data stopped coming
+       { StopStream(); printf("RF_Acq.Exec() ... SDR.ReadAsync() failed => SDR.Close()\n"); continue; }
+       if(Blocks==0) { usleep(10000); continue; }                          // no time reference yet
+
+       if((SlotSec+OGN_StartTime)<(Now-2.0))                               // we are so late that the Ring does not hold this slot anymore
+       { printf("RF_Acq.Exec() ... Lost %d time slot(s)\n", (int)floor(Now)-SlotSec);
+         SlotSec=(int)floor(Now)+1; SlotIdxValid=0; }
+
+       int ReadGSM = (GSM_CenterFreq>0) && ((SlotSec%30) == 0);           // do the GSM calibration every 30 seconds
+       int SamplesToRead=OGN_SamplesPerRead;
+       int LifeSlots=2;
+       if( ReadGSM || (QueueSize()>=OutQueue.Ctrl.HighWater) ) { SamplesToRead/=2; LifeSlots=1; }
+
+       uint32_t StartIdx;                                                  // first sample of this slot
+       if(!Ring.TimeToIndex(StartIdx, SlotSec+OGN_StartTime)) { usleep(10000); continue; }
+       if(SlotIdxValid)                                                    // follow the sample counter from the previous slot
+       { uint32_t Ref; double RefTime, Period; Ring.getReference(Ref, RefTime, Period);
+         uint32_t CountIdx = SlotIdx + (uint32_t)floor(1.0/Period+0.5);    // one second later by the sample clock
+         int32_t Drift = (int32_t)(StartIdx-CountIdx);
+         if(abs(Drift)<(SampleRate/1000)) StartIdx=CountIdx; }             // re-anchor on the time reference only when drifted by more than 1ms
+
+       if(WaitForSamples(StartIdx, SamplesToRead)<0) continue;
+       SampleBuffer<uint8_t> *Buffer = OutQueue.New();
+       int Read=Ring.Read(*Buffer, StartIdx, SamplesToRead);               // cut the slot out of the Ring
+       SlotIdx=StartIdx; SlotIdxValid=1; SlotSec++;
+       if(Read>0)
+       { Buffer->Rate=SampleRate; Buffer->Freq=CurrCenterFreq;
+         ProcessSlot(Buffer, LifeSlots); }
+       else
+       { OutQueue.Drop(Buffer); printf("RF_Acq.Exec() ... Ring overrun: lost a time slot\n"); }
+
+       if(ReadGSM)                                                         // GSM in the second half-slot
+       { setTuneGSM();
+         uint32_t GSM_Idx=0;
+         if( Ring.TimeToIndex(GSM_Idx, SDR.getTime()+0.025)                // let the tuner settle
+          && (WaitForSamples(GSM_Idx, GSM_SamplesPerRead)>=0) )           // no time reference yet: skip the GSM batch
+         { SampleBuffer<uint8_t> *Buffer = GSM_OutQueue.New();
+           if(Ring.Read(*Buffer, GSM_Idx, GSM_SamplesPerRead)>0)
+           { Buffer->Rate=SampleRate; Buffer->Freq=SDR.getCenterFreq();
+             ProcessGSM(Buffer); }
+           else GSM_OutQueue.Drop(Buffer);
+         }
+         setTuneOGN(); }
+
+       int NextCenterFreq = calcCenterFreq(SlotSec);                       // next center frequency for OGN
+       SDR.setCenterFreq(NextCenterFreq); CurrCenterFreq=NextCenterFreq;
+     }
+
+     StopStream();
+     // printf("RF_Acq.Exec() ... Stop\n");
+     return 0; }
+
+   // time slots from a SampleSource instead of the SDR: paced like real time (scaled by ReplaySpeed)
+   // or as fast as the processing can take them, which gives the throughput of the processing chain.
+   void *ExecSource(void)
+   { if(Source->Open()<0) { printf("RF_Acq.Exec() ... cannot open %s\n", Source->getName()); return 0; }
+     printf("RF_Acq.Exec() ... taking time slots from %s\n", Source->getName());
+     double FirstSlotTime=0, FirstWallTime=0;                             // for the real-time pacing
+     double StartWallTime=SDR.getTime(); SourceSlots=0; SourceRate=0; SourcePulses=0;
+     while(!StopReq)
+     { SampleBuffer<uint8_t> *Buffer = OutQueue.New();
+       int Read=Source->Read(*Buffer);
+       if(Read<=0)
+       { OutQueue.Drop(Buffer);
+         if(Read<0) printf("RF_Acq.Exec() ... cannot read from %s\n", Source->getName());
+         break; }
+       if(Buffer->Rate!=SampleRate) printf("RF_Acq.Exec() ... slot sampled at %3.1f MHz, not at RF.SampleRate\n", 1e-6*Buffer->Rate);
+       double Now=SDR.getTime();
+       if(ReplaySpeed>0)                                                   // real-time pacing
+       { double Wait = FirstWallTime + (Buffer->Time-FirstSlotTime)/ReplaySpeed - Now;
+         if( (SourceSlots==0) || (Wait>2.0) || (Wait<(-2.0)) )            // first slot, a gap in the data or we are late: re-anchor
+         { FirstSlotTime=Buffer->Time; FirstWallTime=Now; Wait=0; }
+         if(Wait>0) usleep((int)floor(1e6*Wait+0.5)); }
+       else                                                                // as fast as possible: wait for the queue rather than drop slots
+       { while( (OutQueue.Size()>=OutQueue.Ctrl.Depth) && !StopReq ) usleep(1000); }
+       if(isGSM(Buffer->Freq))                                             // GSM slots (from a synthetic source) go to the GSM calibration
+       { SampleBuffer<uint8_t> *GSM = GSM_OutQueue.New();                 // in a buffer of the GSM queue: each queue keeps its own pool
+         GSM->Copy(*Buffer); OutQueue.Drop(Buffer);
+         ProcessGSM(GSM); continue; }
+       ProcessSlot(Buffer, 2); SourcePulses+=PulseFilt.Pulses;
+       SourceSlots++;
+       Now=SDR.getTime(); if(Now>StartWallTime) SourceRate=SourceSlots/(Now-StartWallTime);
+       if((SourceSlots%100)==0) PrintSourceStats();
+     }
+     PrintSourceStats();
+     printf("RF_Acq.Exec() ... %d slots from %s in %3.1f sec\n", SourceSlots, Source->getName(), SDR.getTime()-StartWallTime);
+     Source->Close();
+     return 0; }
+
+   void PrintSourceStats(void)
+   { char Line[256]; Source->getStatus(Line, 256);
+     printf("RF_Acq.Exec() ... %d slots from %s, %5.2f slots/sec, %d pulses removed %s%s\n",
+             SourceSlots, Source->getName(), SourceRate, SourcePulses, Line[0]?"| truth: ":"", Line); }
+
+   static int isGSM(int Freq) { return (Freq>=(GSM_LowEdge-GSM_ScanStep)) && (Freq<=(GSM_UppEdge+GSM_ScanStep)); }
+
+   int WaitForSamples(uint32_t Idx, int Samples)                           // wait until the Ring holds the given samples
+   { for( ; ; )
+     { if(StopReq || AsyncDone) return -1;
+       int32_t Missing = Samples-Ring.Available(Idx); if(Missing<=0) break;
+       int usec = (int)floor(1e6*Missing/SampleRate)+1000;
+       if(usec>100000) usec=100000;
+       usleep(usec); }
+     return 0; }
+
+   void StopStream(void)
+   { if(SDR.isOpen()) SDR.CancelAsync();
+     AsyncThr.Join();
+     SDR.Close(); }
+
+   static void *AsyncExec(void *Context)
+   { RF_Acq *This = (RF_Acq *)Context;
+     This->AsyncProfile.Apply();
+     This->SDR.ReadAsync(StreamCallback, This, StreamBuffers, StreamBlockSize);   // blocks until cancelled or an error
+     This->AsyncDone=1; return 0; }
+
+   static int StreamCallback(uint8_t *Buffer, int Samples, double SampleTime, double SamplePeriod, void *Context)
+   { RF_Acq *This = (RF_Acq *)Context;
+     This->Ring.Write(Buffer, Samples, SampleTime, SamplePeriod);
+     return This->StopReq; }                                               // non-zero stops ReadAsync()
+
+   int OpenSDR(int CenterFreq)                                             // open the SDR and apply the settings
+   { int Index=(-1);
+     if(DeviceSerial[0]) Index=SDR.getDeviceIndexBySerial(DeviceSerial);
+     if(Index<0) Index=DeviceIndex;
+     SDR.FreqRaster = FreqRaster;
+     if(SDR.Open(Index, CenterFreq, SampleRate)<0)                         // try to open it
+     { printf("RF_Acq.Exec() ... SDR.Open(%d, , ) fails, retry after 1 sec\n", Index); return -1; }
+     SDR.setOffsetTuning(OffsetTuning);
+     if(BiasTee>=0) SDR.setBiasTee(BiasTee);
+     SDR.setTunerGainMode(OGN_GainMode);
+     SDR.setTunerGain(OGN_Gain);
+     SDR.setFreqCorrection(FreqCorr);
+     return 0; }
+
+   void setTuneGSM(void)                                                   // setup for the GSM reception
+   { SDR.setCenterFreq(GSM_CenterFreq);
+     SDR.setTunerGainMode(GSM_GainMode);
+     SDR.setTunerGain(GSM_Gain);
+     GSM_FreqCorr-=(FreqCorr-SDR.getFreqCorrection()); // this is just in case someone changed the frequency correction live
+     SDR.setFreqCorrection(FreqCorr); }
+
+   void setTuneOGN(void)                                                   // back to OGN reception setup
+   { SDR.setTunerGainMode(OGN_GainMode);
+     SDR.setTunerGain(OGN_Gain);
+     if(GSM_Scan)
+     { GSM_CenterFreq+=GSM_ScanStep;
+       if(GSM_CenterFreq>=GSM_UppEdge) GSM_CenterFreq=GSM_LowEdge+GSM_ScanStep/2;
+     }
+   }
+
+   void ProcessSlot(SampleBuffer<uint8_t> *Buffer, int LifeSlots)         // process and pass on an OGN time slot
+   { Buffer->Produced=SDR.getTime();                                  // for the latency of the file source, where the slot time is in the past
+     if( (Source==0) || !Source->isCorrected() )                      // correct the frequency (sign ?), unless the slot was saved corrected already
+       Buffer->Freq += Buffer->Freq * (1e-6*GSM_FreqCorr);
+     if(OGN_SaveRawData>0)                                              // the file is written by the RF_Recorder thread
+     { if( (RecordQueue.Ctrl.Policy==QueueControl::DropNewest) && (RecordQueue.Size()>=RecordQueue.Ctrl.Depth) )
+       { RecordQueue.Ctrl.CountDropped(); printf("RF_Acq.Exec() ... Recorder queue full, slot not saved\n"); } // would be dropped: do not copy it
+       else
+       { SampleBuffer<uint8_t> *Record = RecordQueue.New();
+         Record->Copy(*Buffer);
+         if(RecordQueue.Offer(Record)) OGN_SaveRawData--;
+                                  else printf("RF_Acq.Exec() ... Recorder queue full, slot not saved\n"); }
+     }
+     PulseFilt.Process(*Buffer);
+     if(QueueSize()>=OutQueue.Ctrl.HighWater) printf("RF_Acq.Exec() ... Half time slot\n");
+     // printf("RF_Acq.Exec() ... SDR.Read() => %d, Time=%16.3f, Freq=%6.1fMHz\n", Read, Buffer->Time, 1e-6*Buffer->Freq);
+     if(SnapshotQueue.Size())                                         // when other threads want a copy of this slot
+     { RefSampleBuffer<uint8_t> *Snapshot = SnapshotSet.Get();        // a preallocated one, given back by the last Release()
+       if(Snapshot==0) { Snapshot = new RefSampleBuffer<uint8_t>; Snapshot->Owner=&SnapshotSet; Snapshot->Pool=&SlotPool; }
+       Snapshot->Copy(*Buffer);                                       // one copy shared by all of them
+       while(SnapshotQueue.Size())
+       { SnapshotReceiver *Receiver; SnapshotQueue.Pop(Receiver);
+         Receiver->Push(Snapshot->Acquire()); }
+       Snapshot->Release(); }
+     LastSlotTime=Buffer->Time; CountAllTimeSlots++;
+     Buffer->Queued=SDR.getTime();
+     if(OutQueue.Offer(Buffer)) CountLifeTimeSlots+=LifeSlots;
+                          else printf("RF_Acq.Exec() ... Dropped a slot\n");
+   }
+
+   void ProcessGSM(SampleBuffer<uint8_t> *Buffer)                          // pass on a GSM batch
+   { Buffer->Produced=Buffer->Queued=SDR.getTime();
+     if(!GSM_OutQueue.Offer(Buffer)) printf("RF_Acq.Exec() ... Dropped a GSM batch\n");
+   }
+
    int calcCenterFreq(uint32_t Time)
-   { int HopFreq[4];
-     HopFreq[0] = HoppingPlan.getFrequency(Time, 0, 0);
-     HopFreq[1] = HoppingPlan.getFrequency(Time, 0, 1);
-     HopFreq[2] = HoppingPlan.getFrequency(Time, 1, 0);
-     HopFreq[3] = HoppingPlan.getFrequency(Time, 1, 1);
-     int MidFreq0 = (HopFreq[0]+HopFreq[1]+1)>>1;
-     // int MidFreq1 = (HopFreq[2]+HopFreq[3]+1)>>1;
-     // int MidFreq  = (MidFreq0+MidFreq1+1)>>1;
-     // int FreqDiff =  MidFreq1-MidFreq0;
-     int CenterFreq = MidFreq0;
-     int Band = SampleRate-150000;
-     std::sort(HopFreq, HopFreq+4);
-     // if(abs(FreqDiff)<HalfBand) CenterFreq = MidFreq;
-     if((HopFreq[3]-HopFreq[0])<Band) CenterFreq=(HopFreq[0]+HopFreq[3]+1)>>1;
-     else if((HopFreq[2]-HopFreq[0])<Band) CenterFreq=(HopFreq[0]+HopFreq[2]+1)>>1;
-     else if((HopFreq[3]-HopFreq[1])<Band) CenterFreq=(HopFreq[1]+HopFreq[3]+1)>>1;
-     // printf("calcCenterFreq(%d): %5.1f-%5.1f-%5.1f-%5.1f [%5.1f] => %5.1f [MHz] %c\n",
-     //        Time, 1e-6*HopFreq[0], 1e-6*HopFreq[1], 1e-6*HopFreq[2], 1e-6*HopFreq[3], 1e-6*CenterFreq,
-     //              1e-6*(HopFreq[3]-HopFreq[0]), CenterFreq!=MidFreq0?'*':' ');
-     return CenterFreq; }
+   { return HoppingPlan.getCenterFrequency(Time, SampleRate-150000); }
+
+} ;
+
+// ==================================================================================================
+
+class RF_Spectrogram                                // spectrograms of the OGN time slots for the HTTP server
+{ public:                                           // rendered on its own low-priority thread, not on the acquisition thread
+   Thread Thr;
+   RF_Acq *RF;
+
+   DFT1d<float>            FFT;                     // FFT to create spectrograms
+   int                     FFTsize;
+   float                  *Window;
+   SampleBuffer< std::complex<float> > SpectraBuffer;
+   SampleBuffer<float>     SpectraPwr;
+   SampleBuffer<uint8_t>   Image;
+   JPEG                    JpegImage;               // the most recent spectrogram, served to all requests until there is a newer slot
+   double                  JpegTime;                // [sec] time of the slot in JpegImage
+   RF_Acq::SnapshotReceiver Snapshots;              // copies of the time slots from RF_Acq
+   ThreadProfile           Profile;
+
+  public:
+   RF_Spectrogram(RF_Acq *RF)
+   { this->RF=RF; Window=0; FFTsize=0; JpegTime=0;
+#ifdef SCHED_BATCH
+     Profile.Policy=SCHED_BATCH;
+#endif
+   }
+
+  ~RF_Spectrogram()
+   { Thr.Cancel();
+     if(Window) free(Window); }
+
+   int Preset(void)
+   { FFTsize=(8*RF->SampleRate)/15625;
+     FFT.PresetForward(FFTsize);
+     Window=(float *)realloc(Window, FFTsize*sizeof(float));
+     FFT.SetSineWindow(Window, FFTsize, (float)(1.0/sqrt(FFTsize)) );
+     return 1; }
+
+   int Config(config_t *Config)
+   { Config_Thread(Config, "RF.Threads.Spectrogram", Profile); return 0; }
+
+   void Start(void)
+   { Thr.setExec(ThreadExec); Thr.Create(this); }
+
+   static void *ThreadExec(void *Context)
+   { RF_Spectrogram *This = (RF_Spectrogram *)Context; return This->Exec(); }
+
+   void *Exec(void)
+   { Profile.Apply();
+     for( ; ; )
+     { Socket *Client; RF->SpectrogramQueue.Pop(Client);          // wait for a request
+       if( (JpegTime==0) || (JpegTime!=RF->LastSlotTime) )         // if there is a newer slot than the cached image
+       { RF->SnapshotQueue.Push(&Snapshots);                       // ask for a copy of the next slot
+         RefSampleBuffer<uint8_t> *Slot; Snapshots.Pop(Slot);
+         Render(*Slot); JpegTime=Slot->Time;
+         Slot->Release(); }
+       for( ; ; )                                                  // send the image to this and all other waiting clients
+       { Send(Client);
+         if(RF->SpectrogramQueue.Size()==0) break;
+         RF->SpectrogramQueue.Pop(Client); }
+     }
+     return 0; }
+
+   void Render(SampleBuffer<uint8_t> &Slot)
+   { SlidingFFT(SpectraBuffer, Slot, FFT, Window);
+     SpectraPower(SpectraPwr, SpectraBuffer);                                         // calc. spectra power
+     float BkgNoise=0.33;
+     LogImage(Image, SpectraPwr, (float)BkgNoise, (float)32.0, (float)32.0);         // make the image
+     JpegImage.Compress_MONO8(Image.Data, Image.Len, Image.Samples() ); }            // and into JPEG
+
+   void Send(Socket *Client)
+   { char Header[256];
+     sprintf(Header, "HTTP/1.1 200 OK\r\nCache-Control: no-cache\r\nContent-Type: image/jpeg\r\nRefresh: 5\r\n\
+Content-Disposition: attachment; filename=\"%s_%07.3fMHz_%03.1fMsps_%10dsec.jpg\"\r\n\r\n",
+              RF->FilePrefix, 1e-6*SpectraBuffer.Freq, 1e-6*SpectraBuffer.Rate*SpectraBuffer.Len/2, (uint32_t)floor(SpectraBuffer.Date+SpectraBuffer.Time));
+     Client->Send(Header);
+     Client->Send(JpegImage.Data, JpegImage.Size);
+     Client->SendShutdown(); Client->Close(); delete Client; }
+
+} ;
+
+// ==================================================================================================
+
+class RF_RawSender                                  // raw data of the OGN time slots for the HTTP server
+{ public:                                           // sent from its own thread, thus a slow client does not stall the acquisition
+   Thread Thr;
+   RF_Acq *RF;
+   RF_Acq::SnapshotReceiver Snapshots;              // copies of the time slots from RF_Acq
+   ThreadProfile Profile;
+
+  public:
+   RF_RawSender(RF_Acq *RF)
+   { this->RF=RF;
+#ifdef SCHED_BATCH
+     Profile.Policy=SCHED_BATCH;
+#endif
+   }
+  ~RF_RawSender() { Thr.Cancel(); }
+
+   int Config(config_t *Config)
+   { Config_Thread(Config, "RF.Threads.RawSender", Profile); return 0; }
+
+   void Start(void)
+   { Thr.setExec(ThreadExec); Thr.Create(this); }
+
+   static void *ThreadExec(void *Context)
+   { RF_RawSender *This = (RF_RawSender *)Context; return This->Exec(); }
+
+   void *Exec(void)
+   { Profile.Apply();
+     for( ; ; )
+     { Socket *Client; RF->RawDataQueue.Pop(Client);              // wait for a request
+       RF->SnapshotQueue.Push(&Snapshots);                         // ask for a copy of the next slot
+       RefSampleBuffer<uint8_t> *Slot; Snapshots.Pop(Slot);
+       for( ; ; )                                                  // send it to this and all other waiting clients
+       { Send(Client, *Slot);
+         if(RF->RawDataQueue.Size()==0) break;
+         RF->RawDataQueue.Pop(Client); }
+       Slot->Release(); }
+     return 0; }
+
+   void Send(Socket *Client, SampleBuffer<uint8_t> &Slot)
+   { char Header[256];
+     sprintf(Header, "HTTP/1.1 200 OK\r\nCache-Control: no-cache\r\nContent-Type: audio/basic\r\n\
+Content-Disposition: attachment; filename=\"%s_%07.3fMHz_%03.1fMsps_%14.3fsec.u8\"\r\n\r\n", RF->FilePrefix, 1e-6*Slot.Freq, 1e-6*Slot.Rate, Slot.Time);
+     Client->Send(Header);
+     Client->Send(Slot.Data, Slot.Full);
+     Client->SendShutdown(); Client->Close(); delete Client; }
+
+} ;
+
+// ==================================================================================================
+
+class RF_Recorder                                   // writes the raw OGN time slots (RF.OGN.SaveRawData) to daily files
+{ public:                                           // on its own thread: the file stays open and is written in large blocks
+   Thread Thr;
+   RF_Acq *RF;
+   RawWriter Writer;
+   RawArchiveIndexWriter Index;                     // <FileName>.idx: time, frequency, offset and length of every slot
+   char FileName[64];                               // the file being written, a new one is started when the (UTC) date changes
+   ThreadProfile Profile;
+
+  public:
+   RF_Recorder(RF_Acq *RF)
+   { this->RF=RF; FileName[0]=0;
+#ifdef SCHED_BATCH
+     Profile.Policy=SCHED_BATCH;
+#endif
+   }
+  ~RF_Recorder() { Thr.Cancel(); }
+
+   int Config(config_t *Config)
+   { Config_Thread(Config, "RF.Threads.Recorder", Profile); return 0; }
+
+   void Start(void)
+   { Thr.setExec(ThreadExec); Thr.Create(this); }
+
+   static void *ThreadExec(void *Context)
+   { RF_Recorder *This = (RF_Recorder *)Context; return This->Exec(); }
+
+   void *Exec(void)
+   { Profile.Apply();
+     for( ; ; )
+     { SampleBuffer<uint8_t> *Slot = RF->RecordQueue.Take();         // wait for a slot
+       Write(*Slot);
+       RF->RecordQueue.Recycle(Slot);
+       if(RF->RecordQueue.Size()==0)                                // nothing more waiting:
+       { if(RF->OGN_SaveRawData>0) { Writer.Flush(); Index.Flush(); } // push the data to the file, then the index
+                              else { Writer.Close(); Index.Close(); FileName[0]=0; } // or close it when the recording is done
+       }
+     }
+     return 0; }
+
+   void Write(SampleBuffer<uint8_t> &Slot)
+   { time_t Time=(time_t)floor(Slot.Time);
+     struct tm TM; gmtime_r(&Time, &TM);
+     char Name[64]; snprintf(Name, 64, "%s_%04d.%02d.%02d.u8", RF->FilePrefix, 1900+TM.tm_year, TM.tm_mon+1, TM.tm_mday);
+     if( (!Writer.isOpen()) || strcmp(Name, FileName) )            // first slot or the date has changed
+     { Writer.Close(); Index.Close(); FileName[0]=0;
+       if(Writer.Open(Name)<0) return;
+       Index.Open(Name, RF_Acq::OGN_RawDataSync);
+       strcpy(FileName, Name); }
+     uint64_t Offset=Writer.Tell();
+     if(Serialize_WriteSync(&Writer, RF_Acq::OGN_RawDataSync)<0) return;
+     if(Slot.Serialize(&Writer)<0) return;
+     Index.Add(Slot.Time+Slot.Date, Slot.Freq, Slot.Rate, Offset, Writer.Tell()-Offset); }
 
 } ;
 
@@ -378,26 +857,31 @@ template <class Float>
 { public:
 
    Thread Thr;                                      // processing thread
+   ThreadProfile Profile;                           // CPU and scheduling of the processing thread
+   StageStats    Stats;                             // CPU, wall, wait and latency times per slot
    volatile int StopReq;
    RF_Acq *RF;
 
    int              Enable;
    ToneFilter<Float> ToneFilt;
 
-   ReuseObjectQueue< SampleBuffer< std::complex<Float> > > OutQueue;
+   SPSC_ReuseObjectQueue< SampleBuffer< std::complex<Float> > > OutQueue;
 
   public:
 
    Inp_Filter(RF_Acq *RF)
-   { this->RF=RF; Config_Defaults(); Preset(); }
+   { this->RF=RF; Config_Defaults(); }                   // Preset() only after the configuration is read
 
    void Config_Defaults(void)
-   { Enable  = 0; ToneFilt.FFTsize = 32768; ToneFilt.Threshold=32; }
+   { Enable  = 0; ToneFilt.FFTsize = 32768; ToneFilt.Threshold=32;
+     OutQueue.Ctrl.Depth=4; }
 
    int Config(config_t *Config)
    { config_lookup_int(Config,   "RF.ToneFilter.Enable",    &Enable);
      config_lookup_int(Config,   "RF.ToneFilter.FFTsize",   &ToneFilt.FFTsize);
      config_lookup_float(Config, "RF.ToneFilter.Threshold", &ToneFilt.Threshold);
+     Config_Queue(Config, "RF.Queue.Filter", OutQueue);
+     Config_Thread(Config, "RF.Threads.Filter", Profile);
      return 0; }
 
    int Preset(void) { return ToneFilt.Preset(); }
@@ -423,18 +907,24 @@ template <class Float>
 
    void *Exec(void)
    { // printf("Inp_Filter.Exec() ... Start\n");
+     Profile.Apply();
      while(!StopReq)
      { if(!Enable) { sleep(1); continue; }
+       SampleBuffer<uint8_t> *InpBuffer = RF->OutQueue.Take();   // here we wait for a new data batch
+       double StartTime=RF->SDR.getTime(); double WaitTime=StartTime-InpBuffer->Queued; // how long the slot waited in the queue
        double ExecTime=getCPU();
-       SampleBuffer<uint8_t> *InpBuffer = RF->OutQueue.Pop();   // here we wait for a new data batch
+       double SlotTime = RF->Source ? InpBuffer->Produced:InpBuffer->Time+InpBuffer->Date;
        // printf("Inp_Filter.Exec() ... Input(%5.3fMHz, %5.3fsec, %dsamples)\n", 1e-6*InpBuffer->Freq, InpBuffer->Time, InpBuffer->Full/2);
        SampleBuffer< std::complex<Float> > *OutBuffer = OutQueue.New();
        ToneFilt.Process(OutBuffer, InpBuffer);
+       OutBuffer->Produced=InpBuffer->Produced;
        RF->OutQueue.Recycle(InpBuffer);                         // let the input buffer go free
        // printf("Inp_Filter.Exec() ... Output(%5.3fMHz, %5.3fsec, %dsamples)\n", 1e-6*OutBuffer->Freq, OutBuffer->Time, OutBuffer->Full/2);
-       if(OutQueue.Size()<4) { OutQueue.Push(OutBuffer); }
-                        else { OutQueue.Recycle(OutBuffer); printf("Inp_Filter.Exec() ... Dropped a slot\n"); }
+       OutBuffer->Queued=RF->SDR.getTime();
+       if(!OutQueue.Offer(OutBuffer)) printf("Inp_Filter.Exec() ... Dropped a slot\n");
        ExecTime=getCPU()-ExecTime; // printf("Inp_FFT.Exec() ... %5.3fsec\n", ExecTime);
+       double Now=RF->SDR.getTime();
+       Stats.Add(ExecTime, Now-StartTime, WaitTime, Now-SlotTime);
      }
      // printf("Inp_FFT.Exec() ... Stop\n");
      return 0; }
@@ -463,6 +953,8 @@ template <class Float>
 { public:
 
    Thread Thr;                                      // processing thread
+   ThreadProfile Profile;                           // CPU and scheduling of the processing thread
+   StageStats    Stats;                             // CPU, wall, wait and latency times per slot
    volatile int StopReq;
    RF_Acq *RF;
    Inp_Filter<Float> *Filter;
@@ -474,25 +966,71 @@ template <class Float>
    DFT1d<Float>     FFT;
 #endif
    Float           *Window;
+   int              FFTbatch;                       // number of slides to FFT at once, 0 or 1 = one slide at a time
+   DFT1dBatch<Float> BatchFFT;                      // for FFTbatch>1
+   Float           *BatchWindow;                    // for FFTbatch>1: Window with the half-swap built in
+   int              FFTthreads;                     // number of threads to share the sliding FFT, 0 = all CPUs
+   SlidingFFT_Pool<Float> FFTpool;                  // for FFTthreads>1
 
    SampleBuffer< std::complex<Float> > OutBuffer;
 
    char OutPipeName[32];                            // name of the pipe to send the RF data (as FFT) to the demodulator and decoder.
    int  OutPipe;
    TCP_DataServer DataServer;
+   ShmRingWriter  ShmRing;                          // when OutPipeName is "shm:<name>": spectra in shared memory
+   int            SparseEnable;                     // [bool] send only the tiles above the noise floor to the pipe/TCP
+   SparseSpectra<Float> Sparse;
+   int            ChannelEnable;                    // [bool] send only the bins of the active hopping channels to the pipe/TCP
+   ChannelSpectra<Float> Channel;
+   SpectraEncoder<Float> Encoder;                   // float, int16, half or log8 on the pipe/TCP
+   int            ChannelizerEnable;                // [bool] polyphase channelizer instead of the sliding FFT: I/Q of the active channels
+   int            ChannelizerBands;                 // 0 = one band per hopping channel
+   PolyphaseChannelizer<Float> Channelizer;
    const static uint32_t OutPipeSync = 0x254F7D00 + sizeof(Float);
 
   public:
    Inp_FFT(RF_Acq *RF, Inp_Filter<Float> *Filter=0)
-   { Window=0; this->RF=RF; this->Filter=Filter; Preset(); OutPipe=(-1); Config_Defaults(); }
+   { Window=0; BatchWindow=0; FFTsize=0; FFTbatch=0; FFTthreads=1; this->RF=RF; this->Filter=Filter; OutPipe=(-1); Config_Defaults(); }
 
    void Config_Defaults(void)
-   { strcpy(OutPipeName, "ogn-rf.fifo"); }
+   { strcpy(OutPipeName, "ogn-rf.fifo");
+     FFTbatch=16; FFTthreads=1; SparseEnable=0; ChannelEnable=0; ChannelizerEnable=0; ChannelizerBands=0; }
 
    int Config(config_t *Config)
    { const char *PipeName = "ogn-rf.fifo";
      config_lookup_string(Config, "RF.PipeName",   &PipeName);
      strcpy(OutPipeName, PipeName);
+     config_lookup_int(Config, "RF.FFT.Batch", &FFTbatch);
+     config_lookup_int(Config, "RF.FFT.Threads", &FFTthreads);
+     config_lookup_int(Config, "RF.DataServer.Queue", &DataServer.MaxQueue);
+     config_lookup_int(Config, "RF.ShmRing.Records", &ShmRing.Records);
+     config_lookup_int(Config, "RF.Sparse.Enable",     &SparseEnable);
+     config_lookup_int(Config, "RF.Sparse.TileBins",   &Sparse.TileBins);
+     config_lookup_int(Config, "RF.Sparse.TileSlides", &Sparse.TileSlides);
+     config_lookup_int(Config, "RF.Sparse.Guard",      &Sparse.Guard);
+     const char *Encoding=0;
+     config_lookup_string(Config, "RF.PipeEncoding", &Encoding);
+     if(Encoding)
+     { Encoder.Encoding=SpectraEncoding::getEncoding(Encoding);
+       if(Encoder.Encoding<0) { printf("Inp_FFT.Config() ... unknown RF.PipeEncoding \"%s\": float is used\n", Encoding); Encoder.Encoding=SpectraEncoding::Float; } }
+     config_lookup_int(Config, "RF.Channels.Enable",    &ChannelEnable);
+     config_lookup_int(Config, "RF.Channels.Width",     &Channel.Width);
+     config_lookup_int(Config, "RF.Channels.GuardBins", &Channel.GuardBins);
+     double Threshold; int IntThreshold;
+     if(config_lookup_float(Config, "RF.Sparse.Threshold", &Threshold)==CONFIG_TRUE) Sparse.Threshold=Threshold;
+     else if(config_lookup_int(Config, "RF.Sparse.Threshold", &IntThreshold)==CONFIG_TRUE) Sparse.Threshold=IntThreshold;
+     config_lookup_int(Config, "RF.Channelizer.Enable",      &ChannelizerEnable);
+     config_lookup_int(Config, "RF.Channelizer.Bands",       &ChannelizerBands);
+     config_lookup_int(Config, "RF.Channelizer.TapsPerBand", &Channelizer.TapsPerBand);
+     double Cutoff;
+     if(config_lookup_float(Config, "RF.Channelizer.Cutoff", &Cutoff)==CONFIG_TRUE) Channelizer.Cutoff=Cutoff;
+     if(DataServer.MaxQueue<1) DataServer.MaxQueue=1;
+     if( (memcmp(OutPipeName, "shm:", 4)==0)                   // the shared memory ring carries the full float spectra only
+      && (ChannelizerEnable || ChannelEnable || SparseEnable || (Encoder.Encoding!=SpectraEncoding::Float)) )
+     { printf("Inp_FFT.Config() ... %s: RF.Channelizer, RF.Channels, RF.Sparse and RF.PipeEncoding are not supported on shared memory, full float spectra are sent\n", OutPipeName);
+       ChannelizerEnable=0; ChannelEnable=0; SparseEnable=0; Encoder.Encoding=SpectraEncoding::Float; }
+     Config_Thread(Config, "RF.Threads.FFT", Profile);
+     if(FFTthreads<=0) FFTthreads = Profile.CPUs ? __builtin_popcountll(Profile.CPUs):sysconf(_SC_NPROCESSORS_ONLN); // all CPUs given to the FFT
      return 0; }
 
   int Preset(void) { return Preset(RF->SampleRate); }
@@ -501,20 +1039,70 @@ template <class Float>
      FFT.PresetForward(FFTsize);
      Window=(Float *)realloc(Window, FFTsize*sizeof(Float));
      FFT.SetSineWindow(Window, FFTsize, (Float)(1.0/sqrt(FFTsize)) );
+#ifndef USE_RPI_GPU_FFT
+     if(FFTthreads>1)
+     { int Workers=FFTpool.Preset(FFTthreads, FFTsize, FFTbatch, Window, &Profile); // the workers run like this thread
+       if(Workers<0) { printf("Inp_FFT.Preset() ... cannot setup the FFT threads\n"); FFTthreads=1; }
+       else printf("Inp_FFT.Preset() ... sliding FFT on %d threads\n", Workers); }
+#endif
+     if(ChannelizerEnable)
+     { int Bands = ChannelizerBands>0 ? ChannelizerBands : PolyphaseChannelizer<Float>::AutoBands(SampleRate, RF->HoppingPlan.ChanSepar);
+       if(Channelizer.Preset(Bands, Channelizer.TapsPerBand)<0)
+       { printf("Inp_FFT.Preset() ... cannot setup the channelizer for %d bands: sliding FFT is used\n", Bands); ChannelizerEnable=0; }
+       else printf("Inp_FFT.Preset() ... channelizer: %d bands of %3.1f kHz, %d taps\n", Bands, 1e-3*SampleRate/Bands, Bands*Channelizer.TapsPerBand); }
+#ifndef USE_RPI_GPU_FFT
+     if( (FFTbatch>1) && (FFTthreads<=1) && !ChannelizerEnable )          // the batch plan only for the single-thread sliding FFT
+     { if(BatchFFT.PresetForward(FFTsize, FFTbatch)<0) { printf("Inp_FFT.Preset() ... cannot setup %d FFTs of %d points\n", FFTbatch, FFTsize); FFTbatch=0; }
+       BatchWindow=(Float *)realloc(BatchWindow, FFTsize*sizeof(Float));
+       memcpy(BatchWindow, Window, FFTsize*sizeof(Float));
+       SwapHalfsWindow(BatchWindow, FFTsize); }
+#endif
      return 1; }
 
-  int SerializeSpectra(int OutPipe)
+  template <class StreamType>
+  int SerializeSpectra(StreamType OutPipe)       // to a pipe/socket or into a DataMessage
   {          int Len=Serialize_WriteSync(OutPipe, OutPipeSync);
     if(Len>=0) { Len=Serialize_WriteName(OutPipe, "FreqCorr"); }
     if(Len>=0) { Len=Serialize_WriteData(OutPipe, (void *)&(RF->FreqCorr),     sizeof(int)   ); }
     if(Len>=0) { Len=Serialize_WriteData(OutPipe, (void *)&(RF->GSM_FreqCorr), sizeof(float) ); }
     if(Len>=0) { Len=Serialize_WriteSync(OutPipe, OutPipeSync); }
-    if(Len>=0) { Len=Serialize_WriteName(OutPipe, "Spectra"); }
-    if(Len>=0) { Len=OutBuffer.Serialize(OutPipe); }
+    char Name[32];                                                                    // the record name tells the encoding
+    if(ChannelizerEnable)
+    { SpectraEncoding::RecordName(Name, "ChannelIQ", Encoder.Encoding);
+      if(Len>=0) { Len=Serialize_WriteName(OutPipe, Name); }
+      if(Len>=0) { Len=Channelizer.Serialize(OutPipe, &Encoder); }
+      return Len; }
+    if(ChannelEnable)
+    { SpectraEncoding::RecordName(Name, "ChannelSpectra", Encoder.Encoding);
+      if(Len>=0) { Len=Serialize_WriteName(OutPipe, Name); }
+      if(Len>=0) { Len=Channel.Serialize(OutPipe, &Encoder); }
+      return Len; }
+    if(SparseEnable)
+    { SpectraEncoding::RecordName(Name, "SparseSpectra", Encoder.Encoding);
+      if(Len>=0) { Len=Serialize_WriteName(OutPipe, Name); }
+      if(Len>=0) { Len=Sparse.Serialize(OutPipe, &Encoder); }
+      return Len; }
+    SpectraEncoding::RecordName(Name, "Spectra", Encoder.Encoding);
+    if(Len>=0) { Len=Serialize_WriteName(OutPipe, Name); }
+    if(Len>=0) { Len=Encoder.Serialize(OutPipe, OutBuffer); }
     return Len; }
 
+  int WriteToShm(void) // copy OutBuffer into the shared memory ring
+  { int Bytes=OutBuffer.Full*sizeof(std::complex<Float>);
+    if( (!ShmRing.isOpen()) || (Bytes>ShmRing.DataSize()) )                            // (re)create when the slots do not fit
+    { if(ShmRing.Open(OutPipeName+4, OutPipeSync, Bytes)<0) return -1;
+      printf("Inp_FFT.Exec() ... spectra to shared memory %s, %d x %d bytes\n", ShmRing.Name, ShmRing.Records, ShmRing.DataSize()); }
+    ShmRing_Record *Record=ShmRing.Begin();
+    Record->FreqCorr=RF->FreqCorr; Record->GSM_FreqCorr=RF->GSM_FreqCorr;
+    Record->Size=OutBuffer.Size; Record->Full=OutBuffer.Full; Record->Len=OutBuffer.Len;
+    Record->Rate=OutBuffer.Rate; Record->Time=OutBuffer.Time+OutBuffer.Date; Record->Freq=OutBuffer.Freq;
+    Record->Bytes=Bytes; memcpy(ShmRing.Data(Record), OutBuffer.Data, Bytes);
+    ShmRing.Commit(Record);
+    return 0; }
+
   int WriteToPipe(void) // write OutBuffer to the output pipe
-  { if( (OutPipe<0) && (!DataServer.isListenning()) )
+  { if(memcmp(OutPipeName, "shm:", 4)==0) return WriteToShm();       // full float spectra: Config() turned off the other outputs
+    if( (OutPipe<0) && (!DataServer.isListenning()) )
     { const char *Colon=strchr(OutPipeName, ':');
       if(Colon)
       { int Port=atoi(Colon+1);
@@ -537,19 +1125,24 @@ template <class Float>
       }
       if( (OutPipe<0) && (!DataServer.isListenning()) ) return -1;
     }
-    if(DataServer.isListenning())
-    { for(int Idx=0; Idx<DataServer.Clients(); Idx++)                                // loop over clients
-      { int Len=SerializeSpectra(DataServer.Client[Idx]);                            // serialize same data to every client
-        if(Len<0)
-        { printf("Inp_FFT.Exec() ... Dropped a client\n");
-          DataServer.Close(Idx); }                                                   // if anything goes wrong: close this client
-      }
-      int Ret=DataServer.RemoveClosed();                                             // remove closed clients from the list
-      Ret=DataServer.Accept();             	                                     // check for more clients who might be waiting to connect
-      if(Ret>0) printf("Inp_FFT.Exec() ... Accepted new client (%d clients now)\n", DataServer.Clients() );
-    }
+    if(ChannelizerEnable) { }                                                         // the channelizer output is already selective
+    else if(ChannelEnable) Channel.Process(OutBuffer, RF->HoppingPlan);               // select the channels once for all outputs
+    else if(SparseEnable && (Sparse.Process(OutBuffer)<0))                            // or the tiles
+    { printf("Inp_FFT.Exec() ... %d bins not a multiple of RF.Sparse.TileBins=%d: sparse output disabled\n", OutBuffer.Len, Sparse.TileBins);
+      SparseEnable=0; }
+    if(ChannelizerEnable) Encoder.Encode(Channelizer.Output);                         // and encode once
+    else if(ChannelEnable) Encoder.Encode(Channel.Output);
+    else if(SparseEnable) Encoder.Encode(Sparse.Tiles);
+    else Encoder.Encode(OutBuffer);
+    if(DataServer.isListenning() && DataServer.Clients())
+    { DataMessage *Msg=DataServer.New();                                              // serialize once for all the clients
+      Msg->Time = ChannelizerEnable ? Channelizer.Output.Time+Channelizer.Output.Date : OutBuffer.Time+OutBuffer.Date;
+      if(SerializeSpectra(Msg)>=0) DataServer.Send(Msg);                              // the I/O thread sends it to every client
+      Msg->Release(); }
     if(OutPipe>=0)
-    { int Len=SerializeSpectra(OutPipe);
+    { Serialize_Gather Gather;                                                        // the whole slot with a single writev()
+      int Len=SerializeSpectra(&Gather);
+      if(Len>=0) Len=Gather.Write(OutPipe);
       if(Len<0) { printf("Inp_FFT.Exec() ... Error while writing to %s\n", OutPipeName); close(OutPipe); OutPipe=(-1); return -1; }
     }
     return 0; }
@@ -559,7 +1152,8 @@ template <class Float>
 
   ~Inp_FFT()
    { Thr.Cancel();
-     if(Window) free(Window); }
+     if(Window) free(Window);
+     if(BatchWindow) free(BatchWindow); }
 
    double getCPU(void) // get CPU time for this thread
    {
@@ -573,26 +1167,48 @@ template <class Float>
    static void *ThreadExec(void *Context)
    { Inp_FFT *This = (Inp_FFT *)Context; return This->Exec(); }
 
+  template <class InpType>
+   int RunChannelizer(SampleBuffer<InpType> &InpBuffer) // the channels of the hopping plan active in this slot
+   { uint32_t Freq[PolyphaseChannelizer<Float>::MaxChannels];
+     int Active=RF->HoppingPlan.getActiveFrequencies(Freq, (uint32_t)floor(InpBuffer.Time+InpBuffer.Date));
+     return Channelizer.Process(InpBuffer, Freq, Active); }
+
    void *Exec(void)
    { // printf("Inp_FFT.Exec() ... Start\n");
+     Profile.Apply();
      while(!StopReq)
-     { double ExecTime=getCPU();
+     { double WaitTime=0, StartTime=0, ExecTime=0;                // [sec] WaitTime = how long the slot waited in the queue
+       double SlotTime=0;                                         // [sec] when the slot was acquired (or produced, for a file source)
 #ifndef USE_RPI_GPU_FFT
        if(Filter && Filter->Enable)
-       { SampleBuffer< std::complex<Float> > *InpBuffer = Filter->OutQueue.Pop();
+       { SampleBuffer< std::complex<Float> > *InpBuffer = Filter->OutQueue.Take();
+         StartTime=RF->SDR.getTime(); ExecTime=getCPU(); WaitTime=StartTime-InpBuffer->Queued;
+         SlotTime = RF->Source ? InpBuffer->Produced:InpBuffer->Time+InpBuffer->Date;
          // printf("Inp_FFT.Exec() ... (%5.3fMHz, %5.3fsec, %dsamples)\n", 1e-6*InpBuffer->Freq, InpBuffer->Time, InpBuffer->Full/2);
-         SlidingFFT(OutBuffer, *InpBuffer, FFT, Window);  // Process input samples, produce FFT spectra
+         if(ChannelizerEnable) RunChannelizer(*InpBuffer);
+         else SlidingFFT(OutBuffer, *InpBuffer, FFT, Window);  // Process input samples, produce FFT spectra
          Filter->OutQueue.Recycle(InpBuffer);
        }
        else
 #endif
-       { SampleBuffer<uint8_t> *InpBuffer = RF->OutQueue.Pop(); // here we wait for a new data batch
+       { SampleBuffer<uint8_t> *InpBuffer = RF->OutQueue.Take(); // here we wait for a new data batch
+         StartTime=RF->SDR.getTime(); ExecTime=getCPU(); WaitTime=StartTime-InpBuffer->Queued;
+         SlotTime = RF->Source ? InpBuffer->Produced:InpBuffer->Time+InpBuffer->Date;
          // printf("Inp_FFT.Exec() ... (%5.3fMHz, %5.3fsec, %dsamples)\n", 1e-6*InpBuffer->Freq, InpBuffer->Time, InpBuffer->Full/2);
+         if(ChannelizerEnable) RunChannelizer(*InpBuffer);       // I/Q of the active channels instead of the spectra
+         else
+#ifndef USE_RPI_GPU_FFT
+         if(FFTthreads>1) FFTpool.Process(OutBuffer, *InpBuffer);        // slides shared by several threads
+         else if(FFTbatch>1) SlidingFFT(OutBuffer, *InpBuffer, BatchFFT, BatchWindow); // FFTbatch slides at a time
+         else
+#endif
          SlidingFFT(OutBuffer, *InpBuffer, FFT, Window);  // Process input samples, produce FFT spectra
          RF->OutQueue.Recycle(InpBuffer);
        }
        WriteToPipe(); // here we send the FFT spectra in OutBuffer to the demodulator
        ExecTime=getCPU()-ExecTime; // printf("Inp_FFT.Exec() ... %5.3fsec\n", ExecTime);
+       double Now=RF->SDR.getTime();                              // CPU time of the FFTpool workers is not included
+       Stats.Add(ExecTime, Now-StartTime, WaitTime, Now-SlotTime);
      }
      // printf("Inp_FFT.Exec() ... Stop\n");
      if(OutPipe>=0) { close(OutPipe); OutPipe=(-1); }
@@ -607,6 +1223,8 @@ template <class Float>
 { public:
 
    Thread Thr;                                      // processing thread
+   ThreadProfile Profile;                           // CPU and scheduling of the processing thread
+   StageStats    Stats;                             // CPU, wall, wait and latency times per slot
    volatile int StopReq;
    RF_Acq *RF;                                      // pointer to the RF acquisition
 
@@ -630,7 +1248,10 @@ template <class Float>
 
   public:
    GSM_FFT(RF_Acq *RF)
-   { Window=0; this->RF=RF; Preset(); }
+   { Window=0; FFTsize=0; this->RF=RF; }
+
+   int Config(config_t *Config)
+   { Config_Thread(Config, "RF.Threads.GSM", Profile); return 0; }
 
    int Preset(void) { return Preset(RF->SampleRate); }
    int Preset(int SampleRate)
@@ -662,9 +1283,12 @@ template <class Float>
 
    void *Exec(void)
    { // printf("GSM_FFT.Exec() ... Start\n");
+     Profile.Apply();
      while(!StopReq)
-     { double ExecTime=getCPU();
-       SampleBuffer<uint8_t> *InpBuffer = RF->GSM_OutQueue.Pop();                         // get data sample on a GSM frequency
+     { SampleBuffer<uint8_t> *InpBuffer = RF->GSM_OutQueue.Take();                         // get data sample on a GSM frequency
+       double StartTime=RF->SDR.getTime(); double WaitTime=StartTime-InpBuffer->Queued;    // how long the batch waited in the queue
+       double ExecTime=getCPU();
+       double SlotTime = RF->Source ? InpBuffer->Produced:InpBuffer->Time+InpBuffer->Date;
        // printf("GSM_FFT.Exec() ... (%5.3fMHz, %5.3fsec, %dsamples)\n", 1e-6*InpBuffer->Freq, InpBuffer->Time, InpBuffer->Full/2);
        SlidingFFT(Spectra, *InpBuffer, FFT, Window);                                      // perform sliding-FFT on the data
        SpectraPower(Power, Spectra);                                                      // calculate power of the spectra
@@ -680,6 +1304,8 @@ template <class Float>
          Client->SendShutdown(); Client->Close(); delete Client; }
        Process();                                                                         // process the data to find frequency calibration markers
        ExecTime=getCPU()-ExecTime; // printf("GSM_FFT.Exec() ... %5.3fsec\n", ExecTime);
+       double Now=RF->SDR.getTime();
+       Stats.Add(ExecTime, Now-StartTime, WaitTime, Now-SlotTime);
      }
      // printf("GSM_FFT.Exec() ... Stop\n");
      return 0; }
@@ -813,14 +1439,22 @@ template <class Float>
 
    int                 Port;      // listenning port
    Thread              Thr;       // processing thread
+   ThreadProfile       Profile;   // CPU and scheduling of the processing thread
    RF_Acq             *RF;        // pointer to RF acquisition
    GSM_FFT<Float>     *GSM;
+   Inp_Filter<Float>  *Filter;
+   Inp_FFT<Float>     *FFT;
+   RF_Spectrogram     *Spectrograms; // only for the status of their threads
+   RF_RawSender       *RawSender;
+   RF_Recorder        *Recorder;
    char                Host[32];  // Host name
    char     ConfigFileName[PATH_MAX];
 
   public:
-   HTTP_Server(RF_Acq *RF, GSM_FFT<Float> *GSM)
-   { this->RF=RF; this->GSM=GSM;
+   HTTP_Server(RF_Acq *RF, GSM_FFT<Float> *GSM, Inp_Filter<Float> *Filter, Inp_FFT<Float> *FFT,
+               RF_Spectrogram *Spectrograms, RF_RawSender *RawSender, RF_Recorder *Recorder)
+   { this->RF=RF; this->GSM=GSM; this->Filter=Filter; this->FFT=FFT;
+     this->Spectrograms=Spectrograms; this->RawSender=RawSender; this->Recorder=Recorder;
      Host[0]=0; SocketAddress::getHostName(Host, 32);
      Config_Defaults(); }
 
@@ -829,7 +1463,9 @@ template <class Float>
      Port=8080; }
 
    int Config(config_t *Config)
-   { config_lookup_int(Config, "HTTP.Port", &Port); return 0; }
+   { config_lookup_int(Config, "HTTP.Port", &Port);
+     Config_Thread(Config, "RF.Threads.HTTP", Profile);
+     return 0; }
 
    void Start(void)
    { if(Port<=0) return;
@@ -843,6 +1479,7 @@ template <class Float>
 
    void *Exec(void)
    { printf("HTTP_Server.Exec() ... Start\n");
+     Profile.Apply();
      while(1)
      { Socket Listen;
        // if(Listen.Create_STREAM()<0) { printf("HTTP_Server.Exec() ... Cannot Create_STREAM()\n"); sleep(1); continue; }
@@ -1000,9 +1637,25 @@ Refresh: 5\r\n\
      if(RF->BiasTee>=0)
        dprintf(Client->SocketFile, "<tr><td>RF.BiasTee</td><td align=right><b>%d</b></td></tr>\n",                    RF->BiasTee);
      dprintf(Client->SocketFile, "<tr><td>RF.OffsetTuning</td><td align=right><b>%d</b></td></tr>\n",                 RF->OffsetTuning);
+     dprintf(Client->SocketFile, "<tr><td>RF.Streaming</td><td align=right><b>%d</b></td></tr>\n",                    RF->Streaming);
+     dprintf(Client->SocketFile, "<tr><td>RF.FFTW.Planner</td><td align=right><b>%s</b></td></tr>\n",                FFTW_getPlanner());
+     if(RF->Source)
+     { dprintf(Client->SocketFile, "<tr><td>Sample source</td><td align=right><b>%s</b></td></tr>\n",              RF->Source->getName());
+       dprintf(Client->SocketFile, "<tr><td>RF.Replay.Speed</td><td align=right><b>%3.1f</b></td></tr>\n",         RF->ReplaySpeed);
+       dprintf(Client->SocketFile, "<tr><td>Slots from source</td><td align=right><b>%d, %5.2f/sec</b></td></tr>\n", RF->SourceSlots, RF->SourceRate);
+       dprintf(Client->SocketFile, "<tr><td>Pulses removed</td><td align=right><b>%d</b></td></tr>\n",             RF->SourcePulses);
+       char Line[256]; if(RF->Source->getStatus(Line, 256)>0)
+         dprintf(Client->SocketFile, "<tr><td>Source truth</td><td align=right><b>%s</b></td></tr>\n",             Line); }
      dprintf(Client->SocketFile, "<tr><td>Fine calib. FreqCorr</td><td align=right><b>%+5.1f ppm</b></td></tr>\n",    RF->GSM_FreqCorr);
      dprintf(Client->SocketFile, "<tr><td>RF.PulseFilter.Threshold</td><td align=right><b>%d</b></td></tr>\n",        RF->PulseFilt.Threshold);
      dprintf(Client->SocketFile, "<tr><td>RF.PulseFilter duty</td><td align=right><b>%5.1f ppm</b></td></tr>\n",    1e6*RF->PulseFilt.Duty);
+     SlotStats Slot=RF->PulseFilt.getStats();
+     if(Slot.Samples)                                                                   // only with RF.PulseFilter.Threshold>0 and RF.PulseFilter.Stats=1
+     { dprintf(Client->SocketFile, "<tr><td>RF slot power</td><td align=right><b>%5.1f dB</b></td></tr>\n",            10*log10(Slot.MeanPower()+1e-3));
+       dprintf(Client->SocketFile, "<tr><td>RF slot DC offset I/Q</td><td align=right><b>%+5.2f/%+5.2f</b></td></tr>\n", Slot.DC_I(), Slot.DC_Q());
+       dprintf(Client->SocketFile, "<tr><td>RF slot clipping</td><td align=right><b>%5.1f ppm</b></td></tr>\n",        1e6*Slot.ClipRatio()); }
+     else
+       dprintf(Client->SocketFile, "<tr><td>RF slot power, DC offset, clipping</td><td align=right><b>off: need RF.PulseFilter.Threshold&gt;0 and RF.PulseFilter.Stats=1</b></td></tr>\n");
      // dprintf(Client->SocketFile, "<tr><td>RF.ToneFilter.Enable</td><td align=right><b>%d</b></td></tr>\n",                  FFT->Filter->Enable);
      // dprintf(Client->SocketFile, "<tr><td>RF.ToneFilter.FFTsize</td><td align=right><b>%d</b></td></tr>\n",                 FFT->Filter->FFTsize);
      // dprintf(Client->SocketFile, "<tr><td>RF.ToneFilter.Threshold</td><td align=right><b>%3.1f</b></td></tr>\n",            FFT->Filter->Threshold);
@@ -1017,6 +1670,37 @@ Refresh: 5\r\n\
      dprintf(Client->SocketFile, "<tr><td>RF.GSM.Scan</td><td align=right><b>%d</b></td></tr>\n",                     RF->GSM_Scan);
      dprintf(Client->SocketFile, "<tr><td>RF.GSM.Gain</td><td align=right><b>%4.1f dB</b></td></tr>\n",           0.1*RF->GSM_Gain);
      dprintf(Client->SocketFile, "<tr><td>RF.GSM.SensTime</td><td align=right><b>%5.3f sec</b></td></tr>\n", (double)(RF->GSM_SamplesPerRead)/RF->SampleRate);
+     if(RF->SlotPool.Blocks)
+       dprintf(Client->SocketFile, "<tr><td>Slot buffers%s</td><td align=right><b>%d/%d free, %d missed</b></td></tr>\n",
+               RF->SlotPool.HugePages ? " (huge pages)":"", RF->SlotPool.getFree(), RF->SlotPool.Blocks, RF->SlotPool.getMisses());
+     Status_Queue(Client->SocketFile, "OGN", RF->OutQueue);
+     if(Filter->Enable) Status_Queue(Client->SocketFile, "Filter", Filter->OutQueue);
+     Status_Queue(Client->SocketFile, "GSM", RF->GSM_OutQueue);
+     if(RF->RecordQueue.Ctrl.Enqueued || RF->RecordQueue.Ctrl.Dropped) Status_Queue(Client->SocketFile, "Record", RF->RecordQueue);
+     Status_Thread(Client->SocketFile, "RF",     RF->Profile);
+     if(RF->Streaming) Status_Thread(Client->SocketFile, "Async", RF->AsyncProfile);
+     if(Filter->Enable) Status_Thread(Client->SocketFile, "Filter", Filter->Profile);
+     Status_Thread(Client->SocketFile, "FFT",    FFT->Profile);
+     Status_Thread(Client->SocketFile, "GSM",    GSM->Profile);
+     Status_Thread(Client->SocketFile, "HTTP",   Profile);
+     Status_Thread(Client->SocketFile, "Spectrogram", Spectrograms->Profile);
+     Status_Thread(Client->SocketFile, "RawSender",   RawSender->Profile);
+     Status_Thread(Client->SocketFile, "Recorder",    Recorder->Profile);
+     Status_Stage(Client->SocketFile, "Filter", Filter->Stats);
+     Status_Stage(Client->SocketFile, "FFT",    FFT->Stats);
+     Status_Stage(Client->SocketFile, "GSM",    GSM->Stats);
+     if(FFT->ChannelizerEnable)
+       dprintf(Client->SocketFile, "<tr><td>Channelizer: %d bands</td><td align=right><b>%d channels x %d samples at %3.1f kHz</b></td></tr>\n",
+               FFT->Channelizer.Bands, FFT->Channelizer.Channels, FFT->Channelizer.Output.Len, 1e-3*FFT->Channelizer.Output.Rate);
+     else if(FFT->ChannelEnable)
+       dprintf(Client->SocketFile, "<tr><td>Channel spectra</td><td align=right><b>%d channels x %d bins of %d</b></td></tr>\n",
+               FFT->Channel.Channels, FFT->Channel.Bins, FFT->Channel.Len);
+     else if(FFT->SparseEnable)
+       dprintf(Client->SocketFile, "<tr><td>Sparse spectra: %dx%d tiles</td><td align=right><b>%d/%d sent (%3.1f%%)</b></td></tr>\n",
+               FFT->Sparse.TileSlides, FFT->Sparse.TileBins, FFT->Sparse.Sent, FFT->Sparse.TimeTiles*FFT->Sparse.FreqTiles, 100*FFT->Sparse.Occupancy());
+     if(FFT->DataServer.isListenning())
+     { char Line[1024]; FFT->DataServer.Status(Line, 1024, RF->SDR.getTime(), "<br />");
+       dprintf(Client->SocketFile, "<tr><td>Data server: %d clients</td><td align=right><b>%s</b></td></tr>\n", FFT->DataServer.Clients(), Line); }
 
 
      dprintf(Client->SocketFile, "</table>\n");
@@ -1043,8 +1727,11 @@ RF spectrograms:\r\n\
 
   Inp_FFT<float>     FFT(&RF, &Filter);          // FFT for OGN demodulator
   GSM_FFT<float>     GSM(&RF);                   // GSM frequency calibration
+  RF_Spectrogram     Spectrograms(&RF);          // OGN spectrograms for the HTTP server
+  RF_RawSender       RawSender(&RF);             // OGN raw time slots for the HTTP server
+  RF_Recorder        Recorder(&RF);              // OGN raw time slots to files (RF.OGN.SaveRawData)
 
-  HTTP_Server<float> HTTP(&RF, &GSM);            // HTTP server to show status and spectrograms
+  HTTP_Server<float> HTTP(&RF, &GSM, &Filter, &FFT, &Spectrograms, &RawSender, &Recorder); // HTTP server to show status and spectrograms
 
 void SigHandler(int signum) // Signal handler, when user pressed Ctrl-C or process stops for whatever reason
 { RF.StopReq=1; }
@@ -1109,6 +1796,9 @@ int PrintUserValues(void)
   printf("RF.GSM.CenterFreq=%7.3f MHz\n", 1e-6*RF.GSM_CenterFreq);
   printf("RF.GSM.Scan=%d\n",                   RF.GSM_Scan);
   printf("RF.GSM.Gain=%3.1f dB\n",         0.1*RF.GSM_Gain);
+  Print_Stage("Filter", Filter.Stats);
+  Print_Stage("FFT",    FFT.Stats);
+  Print_Stage("GSM",    GSM.Stats);
   return 0; }
 
 int UserCommand(char *Cmd)
@@ -1160,8 +1850,20 @@ int main(int argc, char *argv[])
   sigaction(SIGQUIT, &SigAction, 0);
   sigaction(SIGPIPE, &SigIgnore, 0);              // we want to ignore pipe/fifo read/write errors, we handle them by return codes
 
+  char FFTW_Wisdom[256]; FFTW_Wisdom[0]=0;       // FFTW planner setup must come before any FFT is prepared
+  const char *Planner=0;
+  config_lookup_string(&Config, "RF.FFTW.Planner", &Planner);
+  if(Planner && (FFTW_setPlanner(Planner)<0)) printf("Unknown RF.FFTW.Planner = %s, using %s\n", Planner, FFTW_getPlanner());
+  const char *Wisdom=0;
+  config_lookup_string(&Config, "RF.FFTW.Wisdom", &Wisdom);
+  if(Wisdom)
+  { strncpy(FFTW_Wisdom, Wisdom, 256); FFTW_Wisdom[255]=0;
+    if(FFTW_ImportWisdom(FFTW_Wisdom)) printf("FFTW wisdom read from %s\n", FFTW_Wisdom); }
+  double PlanTime=RF.SDR.getTime();
+
   RF.Config_Defaults();
   RF.Config(&Config);
+  RF.PresetBuffers();
 
   Filter.Config_Defaults();
   Filter.Config(&Config);
@@ -1171,11 +1873,26 @@ int main(int argc, char *argv[])
   FFT.Config(&Config);
   FFT.Preset();
 
+  GSM.Config(&Config);
   GSM.Preset();
+  Spectrograms.Config(&Config);
+  Spectrograms.Preset();
+  RawSender.Config(&Config);
+  Recorder.Config(&Config);
+
+  PlanTime=RF.SDR.getTime()-PlanTime;
+  printf("FFTW plans (%s) ready in %3.1f sec\n", FFTW_getPlanner(), PlanTime);
+  if(FFTW_Wisdom[0])                              // save the wisdom, including the plans just made
+  { if(!FFTW_ExportWisdom(FFTW_Wisdom)) printf("Cannot write FFTW wisdom to %s\n", FFTW_Wisdom); }
 
   HTTP.Config_Defaults();
   if(realpath(ConfigFileName, HTTP.ConfigFileName)==0) HTTP.ConfigFileName[0]=0;
   HTTP.Config(&Config);
+
+  int LockMemory=0;                               // lock all the memory, thus no page faults in the real-time threads
+  config_lookup_int(&Config, "RF.Threads.LockMemory", &LockMemory);
+  if(LockMemory && (mlockall(MCL_CURRENT|MCL_FUTURE)!=0) ) printf("Cannot lock the memory: mlockall() failed\n");
+
   HTTP.Start();
 
   config_destroy(&Config);
@@ -1183,6 +1900,9 @@ int main(int argc, char *argv[])
   if(Filter.Enable) Filter.Start();
   FFT.Start();
   GSM.Start();
+  Spectrograms.Start();
+  RawSender.Start();
+  Recorder.Start();
   RF.Start();
 
   char Cmd[128];
@@ -3,6 +3,29 @@
 #include "buffer.h"
 #include "boxfilter.h"
 
+class SlotStats                                         // statistics of the raw 8-bit I/Q of a slot
+{ public:
+   int      Samples;
+   int64_t  SumI, SumQ;                                 // of the raw bytes
+   int64_t  SumPwr;                                     // of (I-Bias)^2+(Q-Bias)^2
+   int      Clipped;                                    // samples with I or Q at 0 or 255
+
+  public:
+   SlotStats() { Clear(); }
+
+   void Clear(void) { Samples=0; SumI=0; SumQ=0; SumPwr=0; Clipped=0; }
+
+   void Add(uint8_t I, uint8_t Q, int32_t Pwr)         // one sample: inlined in the loop which reads the samples anyway
+   { SumI+=I; SumQ+=Q; SumPwr+=Pwr;
+     Clipped += ((uint8_t)(I+1)<2) | ((uint8_t)(Q+1)<2); } // 255+1 and 0+1 are below 2
+
+   float MeanPower(void) const { return Samples ? (float)SumPwr/Samples : 0; } // [ADC^2]
+   float DC_I(void) const { return Samples ? (float)SumI/Samples-127.5f : 0; } // [ADC] relative to the mid-scale
+   float DC_Q(void) const { return Samples ? (float)SumQ/Samples-127.5f : 0; }
+   float ClipRatio(void) const { return Samples ? (float)Clipped/Samples : 0; }
+
+} ;
+
 class PulseFilter
 { public:
    int Threshold;                                        // apply pulse filter to the the RF samples to remove wideband pulses like radar
@@ -11,27 +34,39 @@ class PulseFilter
    BoxPeakSum<int32_t> PulseBox;
    int Pulses;
    float Duty;
+   int StatsEnable;                                      // [bool] collect the slot statistics within the filter loop (only when the filter is on)
+
+  private:
+   SlotStats Stats[2];                                   // the last two slots: one is read by other threads while the other is written
+   int       StatsIdx;                                   // the one published
 
   public:
-   PulseFilter() { PulseBox.Preset(PulseBoxSize); Threshold=0; Pulses=0; Duty=0; }
+   PulseFilter() { PulseBox.Preset(PulseBoxSize); Threshold=0; Pulses=0; Duty=0; StatsEnable=0; StatsIdx=0; }
+
+   SlotStats getStats(void) const                        // of the last slot, before the pulses were removed: Samples=0 when not collected
+   { return Stats[__atomic_load_n(&StatsIdx, __ATOMIC_ACQUIRE)]; }
 
    int Process(SampleBuffer<uint8_t> &Buffer, uint8_t Bias=127)
-   { PulseBox.Clear(); Pulses=0;
-     if(Threshold<=0) return 0;
+   { PulseBox.Clear(); Pulses=0; Duty=0;
+     SlotStats Slot;                                     // accumulated here, published when complete
      int Samples = Buffer.Samples();
-     if(Samples<PulseBoxSize) return 0;
-     // printf("PulseFilter::Process(Buffer[%d]) (%d)\n", Samples, Threshold);
      uint8_t *Data = Buffer.Data;
+     if( (Threshold<=0) || (Samples<PulseBoxSize) )
+     { if(StatsEnable) PublishStats(Slot);
+       return 0; }
+     // printf("PulseFilter::Process(Buffer[%d]) (%d)\n", Samples, Threshold);
      int Idx;
      for(Idx=0; Idx<(2*PulseBoxSize); Idx+=2)
      { int32_t I = Data[Idx  ]-Bias;
        int32_t Q = Data[Idx+1]-Bias;
        int32_t Pwr = I*I + Q*Q;
+       if(StatsEnable) Slot.Add(Data[Idx], Data[Idx+1], Pwr);
        PulseBox.Process(Pwr); }
      for(    ; Idx<(2*Samples); Idx+=2)
      { int32_t I = Data[Idx  ]-Bias;
        int32_t Q = Data[Idx+1]-Bias;
        int32_t Pwr = I*I + Q*Q;
+       if(StatsEnable) Slot.Add(Data[Idx], Data[Idx+1], Pwr);  // the sample is read here before it can be blanked
        PulseBox.Process(Pwr);
        if(PulseBox.isAtPeak())
        { int32_t PeakAmpl = PulseBox.PeakSum(1);
@@ -54,9 +89,14 @@ class PulseFilter
        }
      }
      // printf("PulseFilter::Process(Buffer[%d]) (%d)  => %d pulses\n", Samples, Threshold, Pulses);
+     if(StatsEnable) { Slot.Samples=Samples; PublishStats(Slot); }
      Duty = (float)Pulses/Samples;
      return Pulses; }
 
+   void PublishStats(const SlotStats &Slot)
+   { int Idx=StatsIdx^1;
+     Stats[Idx]=Slot; __atomic_store_n(&StatsIdx, Idx, __ATOMIC_RELEASE); }
+
    static void SetZero(uint8_t *Data, uint8_t Bias=127)
    { Data[0]=Bias; Data[1]=Bias; }
 
@@ -0,0 +1,193 @@
+#ifndef __RAWARCHIVE_H__
+#define __RAWARCHIVE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "serialize.h"
+#include "buffer.h"
+
+// ==================================================================================================
+// Index for the raw data files (RF.OGN.SaveRawData): next to every <name>.u8 the recorder writes
+// <name>.u8.idx - a header and one RawArchive_Entry per slot: time, frequency, file offset and length.
+// RawArchive opens a data file with its index (or rebuilds the index by scanning when it is missing
+// or does not cover the data file), finds the slot for a given time with a binary search and maps
+// only the slots which are actually read, thus it works on multi-gigabyte files also on 32-bit systems.
+
+struct RawArchive_Header           // at the start of the .idx file
+{ uint32_t Magic;                  // RawArchive_Magic
+  uint32_t Version;
+  uint32_t Sync;                   // the Sync word preceding every slot in the data file
+  uint32_t EntrySize;              // [bytes] sizeof(RawArchive_Entry)
+} ;
+
+struct RawArchive_Entry            // one per slot, in the order of the data file (thus of time)
+{ double   Time;                   // [sec] acquisition time of the slot
+  double   Freq;                   // [Hz] center frequency
+  uint64_t Offset;                 // [bytes] position of the Sync word in the data file
+  uint32_t Length;                 // [bytes] of the record: Sync, SampleBuffer header and data
+  uint32_t Rate;                   // [Hz] sample rate
+} ;
+
+const uint32_t RawArchive_Magic   = 0x58444E49; // "INDX"
+const uint32_t RawArchive_Version = 1;
+const int      RawArchive_SlotHeader = 3*sizeof(int32_t)+3*sizeof(double); // serialized SampleBuffer header
+
+class RawArchiveIndexWriter        // used by the recorder: appends an entry for every slot written
+{ public:
+   FILE *File;
+
+  public:
+   RawArchiveIndexWriter() { File=0; }
+  ~RawArchiveIndexWriter() { Close(); }
+
+   int Open(const char *DataName, uint32_t Sync)
+   { Close();
+     char Name[272]; snprintf(Name, sizeof(Name), "%s.idx", DataName);
+     File=fopen(Name, "ab"); if(File==0) { printf("RawArchiveIndexWriter.Open() ... cannot open %s\n", Name); return -1; }
+     if(ftell(File)==0)
+     { RawArchive_Header Header; Header.Magic=RawArchive_Magic; Header.Version=RawArchive_Version;
+       Header.Sync=Sync; Header.EntrySize=sizeof(RawArchive_Entry);
+       fwrite(&Header, sizeof(Header), 1, File); }
+     return 0; }
+
+   int Add(double Time, double Freq, double Rate, uint64_t Offset, uint32_t Length)
+   { if(File==0) return -1;
+     RawArchive_Entry Entry; memset(&Entry, 0, sizeof(Entry));
+     Entry.Time=Time; Entry.Freq=Freq; Entry.Rate=(uint32_t)floor(Rate+0.5); Entry.Offset=Offset; Entry.Length=Length;
+     return fwrite(&Entry, sizeof(Entry), 1, File)==1 ? 0:-1; }
+
+   void Flush(void) { if(File) fflush(File); } // call after the data file has been flushed: the index never runs ahead of the data
+
+   void Close(void) { if(File) fclose(File); File=0; }
+
+} ;
+
+class RawArchive                   // random access to the slots of a raw data file
+{ public:
+   int       File;                 // the data file
+   uint64_t  FileSize;             // [bytes]
+   uint32_t  Sync;
+   std::vector<RawArchive_Entry> Index; // from the .idx file or rebuilt by scanning the data
+
+  private:
+   void     *Map;                  // the currently mapped slot
+   size_t    MapSize;
+   uint64_t  MapOffset;
+
+  public:
+   RawArchive() { File=(-1); FileSize=0; Sync=0; Map=0; MapSize=0; MapOffset=0; }
+  ~RawArchive() { Close(); }
+
+   int Open(const char *DataName, uint32_t Sync) // returns the number of slots or -1
+   { Close(); this->Sync=Sync;
+     File=open(DataName, O_RDONLY); if(File<0) return -1;
+     struct stat Stat; if(fstat(File, &Stat)<0) { Close(); return -1; }
+     FileSize=Stat.st_size;
+     char Name[272]; snprintf(Name, sizeof(Name), "%s.idx", DataName);
+     uint64_t Covered=ReadIndex(Name);                           // [bytes] of the data file covered by the index
+     if(Covered<FileSize) Rebuild(Covered);                      // index missing or behind: scan the rest of the data
+     return Slots(); }
+
+   void Close(void)
+   { Unmap(); if(File>=0) close(File); File=(-1); FileSize=0; Index.clear(); }
+
+   int Slots(void) const { return Index.size(); }
+
+   int Find(double Time) const     // the first slot at or after Time: binary search, Slots() when past the end
+   { std::vector<RawArchive_Entry>::const_iterator It =
+       std::lower_bound(Index.begin(), Index.end(), Time, TimeLess);
+     return It-Index.begin(); }
+
+   const uint8_t *Record(int Slot) // the record in place (Sync word first), valid until the next call: 0 on error
+   { if( (Slot<0) || (Slot>=Slots()) ) return 0;
+     const RawArchive_Entry &Entry=Index[Slot];
+     long Page=sysconf(_SC_PAGESIZE);
+     uint64_t Start=Entry.Offset-Entry.Offset%Page;              // mmap() needs a page aligned offset
+     size_t   Size=Entry.Offset+Entry.Length-Start;
+     if( (Map==0) || (Start!=MapOffset) || (Size>MapSize) )
+     { Unmap();
+       void *Ptr=mmap(0, Size, PROT_READ, MAP_SHARED, File, Start); if(Ptr==MAP_FAILED) return 0;
+       madvise(Ptr, Size, MADV_SEQUENTIAL);
+       Map=Ptr; MapSize=Size; MapOffset=Start; }
+     return (const uint8_t *)Map+(Entry.Offset-Start); }
+
+   template <class Type>
+    int Read(int Slot, SampleBuffer<Type> &Buffer) // copy the slot into Buffer: number of samples or -1
+    { const uint8_t *Rec=Record(Slot); if(Rec==0) return -1;
+      const uint8_t *Head=Rec+sizeof(uint32_t);
+      int32_t Full, Len; double Time;
+      memcpy(&Full, Head+1*sizeof(int32_t), sizeof(int32_t));
+      memcpy(&Len,  Head+2*sizeof(int32_t), sizeof(int32_t));
+      if( (Full<0) || (Len<=0) || ((uint64_t)Full*sizeof(Type)+RawArchive_SlotHeader+sizeof(uint32_t)>Index[Slot].Length) ) return -1;
+      if(Buffer.Allocate(Full)==0) return -1;
+      Buffer.Full=Full; Buffer.Len=Len;
+      memcpy(&Buffer.Rate, Head+3*sizeof(int32_t),                  sizeof(double));
+      memcpy(&Time,        Head+3*sizeof(int32_t)+sizeof(double),   sizeof(double));
+      memcpy(&Buffer.Freq, Head+3*sizeof(int32_t)+2*sizeof(double), sizeof(double));
+      Buffer.Time=Time; Buffer.Date=0;                              // full time in Time, like RawFileSource
+      memcpy(Buffer.Data, Head+RawArchive_SlotHeader, Full*sizeof(Type));
+      return Buffer.Samples(); }
+
+  private:
+   static bool TimeLess(const RawArchive_Entry &Entry, double Time) { return Entry.Time<Time; }
+
+   void Unmap(void) { if(Map) munmap(Map, MapSize); Map=0; MapSize=0; MapOffset=0; }
+
+   uint64_t ReadIndex(const char *Name) // load the index (through mmap): returns how far it covers the data file
+   { int Idx=open(Name, O_RDONLY); if(Idx<0) return 0;
+     struct stat Stat; if( (fstat(Idx, &Stat)<0) || (Stat.st_size<(off_t)sizeof(RawArchive_Header)) ) { close(Idx); return 0; }
+     void *Ptr=mmap(0, Stat.st_size, PROT_READ, MAP_PRIVATE, Idx, 0); close(Idx);
+     if(Ptr==MAP_FAILED) return 0;
+     const RawArchive_Header *Header=(const RawArchive_Header *)Ptr;
+     uint64_t Covered=0;
+     if( (Header->Magic==RawArchive_Magic) && (Header->Version==RawArchive_Version)
+      && (Header->Sync==Sync) && (Header->EntrySize==sizeof(RawArchive_Entry)) )
+     { int Entries=(Stat.st_size-sizeof(RawArchive_Header))/sizeof(RawArchive_Entry);
+       const RawArchive_Entry *Entry=(const RawArchive_Entry *)(Header+1);
+       Index.reserve(Entries);
+       for(int Idx=0; Idx<Entries; Idx++)
+       { if(Entry[Idx].Offset+Entry[Idx].Length>FileSize) break;  // the data did not make it to the file
+         Index.push_back(Entry[Idx]); Covered=Entry[Idx].Offset+Entry[Idx].Length; }
+     }
+     munmap(Ptr, Stat.st_size);
+     return Covered; }
+
+   int Rebuild(uint64_t From)      // scan the data file for slots, starting at From
+   { if(lseek(File, From, SEEK_SET)<0) return -1;
+     Serialize_Reader Reader(File, 4<<20);
+     int Added=0;
+     for( ; ; )
+     { if(Reader.FindSync(Sync)<0) break;
+       uint64_t Offset=From+Reader.Position-sizeof(uint32_t);
+       const uint8_t *Head=(const uint8_t *)Reader.Peek(RawArchive_SlotHeader); if(Head==0) break;
+       int32_t Full, Len; RawArchive_Entry Entry; memset(&Entry, 0, sizeof(Entry));
+       memcpy(&Full, Head+1*sizeof(int32_t), sizeof(int32_t));
+       memcpy(&Len,  Head+2*sizeof(int32_t), sizeof(int32_t));
+       if( (Full<0) || (Len<=0) ) continue;                      // not a slot header: hunt for the next Sync
+       uint64_t Length=sizeof(uint32_t)+RawArchive_SlotHeader+(uint64_t)Full;
+       if(Offset+Length>FileSize) continue;                      // corrupted length or truncated at the end: hunt for the next Sync
+       double Rate;
+       memcpy(&Rate,       Head+3*sizeof(int32_t),                  sizeof(double));
+       memcpy(&Entry.Time, Head+3*sizeof(int32_t)+sizeof(double),   sizeof(double));
+       memcpy(&Entry.Freq, Head+3*sizeof(int32_t)+2*sizeof(double), sizeof(double));
+       Entry.Rate=(uint32_t)floor(Rate+0.5); Entry.Offset=Offset; Entry.Length=Length;
+       Index.push_back(Entry); Added++;
+       Reader.Skip(Length-sizeof(uint32_t)); }
+     return Added; }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __RAWARCHIVE_H__
@@ -0,0 +1,121 @@
+#ifndef __RAWWRITER_H__
+#define __RAWWRITER_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+// ==================================================================================================
+// Sequential file writer for long raw-data captures: data is collected in a large aligned buffer
+// and written in whole blocks at block-aligned file positions, with O_DIRECT where the file system
+// supports it (thus the page cache is not filled with gigabytes of dirty pages which are then flushed
+// all at once - a typical cause of long write stalls on SD cards). The partial block at the end is kept
+// in the buffer and rewritten together with the following data, so the file content is exactly what
+// has been written, same as with fwrite(). Without O_DIRECT it works as a plain buffered writer.
+
+class RawWriter
+{ public:
+   static const int Align = 4096;  // [bytes] block size for O_DIRECT: buffer address, size and file positions
+   int       File;                 // file descriptor, -1 when closed
+   int       Direct;               // [bool] the file is in O_DIRECT mode
+   char      Name[256];            // name of the open file
+   uint8_t  *Buffer;               // staging buffer, aligned to Align
+   int       BufferSize;           // [bytes] a multiple of Align
+   int       Fill;                 // [bytes] data in the buffer
+   off_t     FilePos;              // file position of Buffer[0], a multiple of Align
+   uint64_t  Written;              // [bytes] total data accepted by Write()
+   uint32_t  Errors;               // number of failed writes
+
+  public:
+   RawWriter() { File=(-1); Direct=0; Name[0]=0; Buffer=0; BufferSize=0; Fill=0; FilePos=0; Written=0; Errors=0; }
+  ~RawWriter() { Close(); free(Buffer); }
+
+   int Preset(int Size=4*1024*1024)
+   { Close();
+     Size = ((Size+Align-1)/Align)*Align; if(Size<Align) Size=Align;
+     free(Buffer); Buffer=0; BufferSize=0;
+     void *Ptr=0; if(posix_memalign(&Ptr, Align, Size)!=0) return -1;
+     Buffer=(uint8_t *)Ptr; BufferSize=Size; return BufferSize; }
+
+   int isOpen(void) const { return File>=0; }
+
+   uint64_t Tell(void) const { return FilePos+Fill; }              // [bytes] file position of the next Write()
+
+   int Open(const char *FileName)                                  // open for append, O_DIRECT when possible
+   { Close(); if(Buffer==0) { if(Preset()<0) return -1; }
+#ifdef O_DIRECT
+     File=open(FileName, O_RDWR | O_CREAT | O_DIRECT, 0644); Direct=1;
+     if(File<0)                                                    // e.g. tmpfs does not support O_DIRECT
+#endif
+     { File=open(FileName, O_RDWR | O_CREAT, 0644); Direct=0; }
+     if(File<0) { printf("RawWriter.Open() ... cannot open %s\n", FileName); return -1; }
+     strncpy(Name, FileName, 255); Name[255]=0;
+     off_t End=lseek(File, 0, SEEK_END); if(End<0) End=0;
+     FilePos=End-End%Align; Fill=End-FilePos;                       // start at the block which holds the end of the file
+     if(Fill>0)                                                     // read its partial content back into the buffer
+     { if(pread(File, Buffer, Align, FilePos)!=Fill) { setDirect(0); FilePos=End; Fill=0; } }
+     return File; }
+
+   int Write(const void *Data, int Bytes)                          // returns Bytes or -1 on error
+   { if(File<0) return -1;
+     const uint8_t *Src=(const uint8_t *)Data;
+     for(int Left=Bytes; Left>0; )
+     { int Copy=BufferSize-Fill; if(Copy>Left) Copy=Left;
+       memcpy(Buffer+Fill, Src, Copy); Fill+=Copy; Src+=Copy; Left-=Copy;
+       if(Fill==BufferSize) { if(WriteBlocks()<0) return -1; }
+     }
+     Written+=Bytes; return Bytes; }
+
+   int Flush(void)                                                 // write everything, including the partial last block
+   { if(File<0) return 0;
+     if(WriteBlocks()<0) return -1;
+     if(Fill==0) return 0;
+     int WasDirect=Direct; setDirect(0);                            // the tail can not go through O_DIRECT
+     int Ret=pwrite(File, Buffer, Fill, FilePos);
+     setDirect(WasDirect);
+     if(Ret!=Fill) { Errors++; printf("RawWriter.Flush() ... write to %s failed\n", Name); return -1; }
+     return 0; }                                                    // the tail stays in the buffer and is rewritten later
+
+   int Close(void)
+   { if(File<0) return 0;
+     int Ret=Flush();
+     close(File); File=(-1); Direct=0; Fill=0; FilePos=0; Name[0]=0;
+     return Ret; }
+
+  private:
+   int WriteBlocks(void)                                           // write the whole blocks, keep the partial one
+   { int Bytes=Fill-Fill%Align; if(Bytes==0) return 0;
+     int Ret=pwrite(File, Buffer, Bytes, FilePos);
+     if( (Ret<0) && (errno==EINVAL) && Direct )                    // O_DIRECT refused after all: continue without
+     { setDirect(0); Ret=pwrite(File, Buffer, Bytes, FilePos); }
+     if(Ret!=Bytes) { Errors++; printf("RawWriter.Write() ... write to %s failed\n", Name); Fill=0; return -1; }
+     FilePos+=Bytes; Fill-=Bytes;
+     if(Fill) memmove(Buffer, Buffer+Bytes, Fill);
+     return Bytes; }
+
+   void setDirect(int Enable)
+   {
+#ifdef O_DIRECT
+     if(File<0) return;
+     if( (Enable!=0) == (Direct!=0) ) return;
+     int Flags=fcntl(File, F_GETFL);
+     if(Flags<0) return;
+     if(fcntl(File, F_SETFL, Enable ? (Flags|O_DIRECT):(Flags&(~O_DIRECT)) )==0) Direct=Enable;
+#endif
+   }
+
+} ;
+
+// so SampleBuffer::Serialize() and the Serialize_Write...() functions can write into a RawWriter
+inline int Serialize_WriteSync(RawWriter *Stream, uint32_t Sync)               { return Stream->Write(&Sync, sizeof(uint32_t)); }
+inline int Serialize_WriteName(RawWriter *Stream, const char *Name)            { return Stream->Write(Name, strlen(Name)+1); }
+inline int Serialize_WriteData(RawWriter *Stream, const void *Data, int Bytes) { return Stream->Write(Data, Bytes); }
+
+// ==================================================================================================
+
+#endif // __RAWWRITER_H__
@@ -237,7 +237,7 @@ class RTLSDR
      int Ret=0;
      if(Callback)
      { Ret=(*(Callback))(Buffer, Samples,                                 // buffer, number of samples
-                         SampleTime - Samples*SamplePeriod, SamplePeriod, // SampleTime = time of the first sample, SamplePeriod = time period of one sample
+                         SampleTime, SamplePeriod,                        // SampleTime = time of the first sample (end of the previous batch), SamplePeriod = time period of one sample
                          CallbackContext);
      }
      if(Ret) CancelAsync();                                               // call the user callback, if it returns non-zero, then stop data acquisition
@@ -0,0 +1,108 @@
+#ifndef __SAMPLERING_H__
+#define __SAMPLERING_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "buffer.h"
+
+// ==================================================================================================
+// Lock-free single-producer/single-consumer ring of complex 8-bit I/Q samples.
+// The producer is the RTLSDR async callback (USB thread), the consumer is the acquisition thread.
+// Sample positions are given by a free-running 32-bit counter: differences are wrap-around safe
+// as long as they stay below 2^31 samples. The producer never blocks: when the consumer is too slow
+// the oldest data is simply overwritten and the consumer detects this by re-checking the counter.
+
+class SampleRing
+{ public:
+   uint8_t  *Data;              // storage: Size complex samples = 2*Size bytes
+   uint32_t  Size;              // [samples] always a power of two
+   uint32_t  Mask;              // Size-1
+   uint32_t  Head;              // [samples] total number of samples written (modulo 2^32)
+
+   uint32_t  RefSeq;            // sequence lock for the time reference below: odd while being updated
+   uint32_t  RefIdx;            // [samples] counter value of the reference sample
+   double    RefTime;           // [sec] time of the reference sample
+   double    RefPeriod;         // [sec] time per sample
+   uint32_t  Blocks;            // number of blocks written
+
+  public:
+   SampleRing() { Data=0; Size=0; Mask=0; Clear(); }
+  ~SampleRing() { Free(); }
+
+   void Free(void) { free(Data); Data=0; Size=0; Mask=0; }
+
+   int Preset(int MinSamples)                                  // allocate for at least MinSamples
+   { uint32_t NewSize=1; while(NewSize<(uint32_t)MinSamples) NewSize<<=1;
+     if(NewSize!=Size)
+     { Free();
+       Data=(uint8_t *)malloc(2*NewSize); if(Data==0) return -1;
+       memset(Data, 127, 2*NewSize);                           // prefault the pages now, not from the USB callback
+       Size=NewSize; Mask=NewSize-1; }
+     Clear(); return Size; }
+
+   void Clear(void)
+   { __atomic_store_n(&Head, 0, __ATOMIC_RELEASE);
+     RefSeq=0; RefIdx=0; RefTime=0; RefPeriod=0; __atomic_store_n(&Blocks, 0, __ATOMIC_RELEASE); }
+
+   uint32_t getHead(void) const { return __atomic_load_n(&Head, __ATOMIC_ACQUIRE); }
+   uint32_t getBlocks(void) const { return __atomic_load_n(&Blocks, __ATOMIC_ACQUIRE); }
+
+   // producer side: append a block of samples, Time = time of the first sample, Period = time per sample
+   void Write(const uint8_t *Block, int Samples, double Time, double Period)
+   { uint32_t Idx=Head;                                        // only the producer modifies Head
+     if((uint32_t)Samples>Size) { Block+=2*(Samples-Size); Idx+=Samples-Size; Samples=Size; }
+     uint32_t Ofs=Idx&Mask; uint32_t Part=Size-Ofs; if(Part>(uint32_t)Samples) Part=Samples;
+     memcpy(Data+2*Ofs, Block, 2*Part);
+     if(Part<(uint32_t)Samples) memcpy(Data, Block+2*Part, 2*(Samples-Part));
+     uint32_t Seq=RefSeq;
+     __atomic_store_n(&RefSeq, Seq+1, __ATOMIC_RELEASE);      // update the time reference under the sequence lock
+     __atomic_thread_fence(__ATOMIC_RELEASE);
+     RefIdx=Idx; RefTime=Time; RefPeriod=Period;
+     __atomic_store_n(&RefSeq, Seq+2, __ATOMIC_RELEASE);
+     __atomic_store_n(&Head, Head+Samples, __ATOMIC_RELEASE);  // only now make the samples visible
+     __atomic_store_n(&Blocks, Blocks+1, __ATOMIC_RELEASE); }
+
+   // consumer side: get a consistent copy of the time reference
+   int getReference(uint32_t &Idx, double &Time, double &Period) const
+   { for( ; ; )
+     { uint32_t Seq=__atomic_load_n(&RefSeq, __ATOMIC_ACQUIRE);
+       if(Seq&1) continue;
+       Idx=RefIdx; Time=RefTime; Period=RefPeriod;
+       __atomic_thread_fence(__ATOMIC_ACQUIRE);
+       if(__atomic_load_n(&RefSeq, __ATOMIC_RELAXED)==Seq) break; }
+     return Period>0; }
+
+   int TimeToIndex(uint32_t &Idx, double Time) const          // sample index corresponding to the given time
+   { uint32_t Ref; double RefTime, Period;
+     if(!getReference(Ref, RefTime, Period)) return 0;
+     Idx = Ref + (int32_t)floor((Time-RefTime)/Period+0.5); return 1; }
+
+   double IndexToTime(uint32_t Idx) const                      // time of the given sample index
+   { uint32_t Ref; double RefTime, Period;
+     if(!getReference(Ref, RefTime, Period)) return 0;
+     return RefTime + (int32_t)(Idx-Ref)*Period; }
+
+   int32_t Available(uint32_t Idx) const { return (int32_t)(getHead()-Idx); } // samples available from Idx on (negative: not there yet)
+   int isLost(uint32_t Idx) const { return Available(Idx)>(int32_t)(Size-(Size>>3)); } // samples from Idx on are (or are being) overwritten
+
+   // consumer side: copy Samples starting at Idx into the buffer, returns number of samples or negative on overrun
+   int Read(SampleBuffer<uint8_t> &Buffer, uint32_t Idx, int Samples)
+   { if(Buffer.Allocate(2, Samples)<=0) return 0;
+     if(Available(Idx)<Samples) return 0;                      // not all samples are there yet
+     if(isLost(Idx)) return -1;                                // already overwritten
+     uint32_t Ofs=Idx&Mask; uint32_t Part=Size-Ofs; if(Part>(uint32_t)Samples) Part=Samples;
+     memcpy(Buffer.Data, Data+2*Ofs, 2*Part);
+     if(Part<(uint32_t)Samples) memcpy(Buffer.Data+2*Part, Data, 2*(Samples-Part));
+     if(isLost(Idx)) return -1;                                // the producer caught up with us while copying
+     Buffer.Full=2*Samples; Buffer.Len=2;
+     Buffer.Time=IndexToTime(Idx); Buffer.Date=0;
+     return Samples; }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __SAMPLERING_H__
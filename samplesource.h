@@ -0,0 +1,310 @@
+#ifndef __SAMPLESOURCE_H__
+#define __SAMPLESOURCE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "serialize.h"
+#include "rawarchive.h"
+#include "freqplan.h"
+
+// ==================================================================================================
+// A source of time slots of raw 8-bit I/Q samples, which RF_Acq can use instead of the RTLSDR device.
+
+class SampleSource
+{ public:
+   virtual ~SampleSource() { }
+
+   virtual int  Open(void) = 0;                                // (re)open the source: negative on error
+   virtual void Close(void) = 0;
+   virtual int  Read(SampleBuffer<uint8_t> &Buffer) = 0;       // get the next time slot: number of samples, 0 at the end of data, negative on error
+   virtual const char *getName(void) const = 0;                // description for the status page
+   virtual int  getStatus(char *Line, int MaxLen) const { Line[0]=0; return 0; } // optional: more details for the status page
+   virtual int  isCorrected(void) const { return 0; }          // [bool] Freq of the slots has the GSM frequency correction applied already
+} ;
+
+// ==================================================================================================
+// Replay of the raw data files written by RF_Acq with RF.OGN.SaveRawData:
+// every time slot is a Sync word followed by a serialized SampleBuffer<uint8_t>
+
+class RawFileSource : public SampleSource
+{ public:
+   char     FileName[256];
+   uint32_t Sync;                                              // the Sync word which precedes every slot
+   int      Loop;                                              // [bool] start over at the end of the file
+   double   StartTime;                                         // [sec] start at the first slot at or after this time (0 = at the start of the file)
+   int      File;                                              // file descriptor, -1 when closed
+   Serialize_Reader Reader;                                    // large reads and a fast scan for the Sync
+   int      Slots;                                             // number of slots read so far
+   int      SkippedBytes;                                      // number of bytes skipped when looking for the Sync
+
+  public:
+   RawFileSource(const char *Name, uint32_t Sync, int Loop=0)
+   { snprintf(FileName, sizeof(FileName), "%s", Name);
+     this->Sync=Sync; this->Loop=Loop; StartTime=0; File=(-1); Slots=0; SkippedBytes=0; }
+
+  ~RawFileSource() { Close(); }
+
+   int Open(void)
+   { Close();
+     File=open(FileName, O_RDONLY); if(File<0) return -1;
+     Reader.Open(File, 4<<20);
+     if(StartTime>0)                                           // jump to the requested time with the index
+     { RawArchive Archive;
+       if(Archive.Open(FileName, Sync)>0)
+       { int Slot=Archive.Find(StartTime);
+         if(Slot<Archive.Slots()) lseek(File, Archive.Index[Slot].Offset, SEEK_SET);
+                             else lseek(File, 0, SEEK_END); }
+     }
+     return 0; }
+
+   void Close(void)
+   { if(File>=0) close(File); File=(-1); }
+
+   int Read(SampleBuffer<uint8_t> &Buffer)
+   { if(File<0) return -1;
+     int Rewinds=0;
+     for( ; ; )
+     { int Skip=Reader.FindSync(Sync);                          // find the start of the next slot
+       if(Skip<0)                                               // end of the file
+       { if( (!Loop) || (Slots==0) || Rewinds ) return 0;
+         lseek(File, 0, SEEK_SET); Reader.Reset(); Rewinds++; continue; } // start over
+       SkippedBytes+=Skip;
+       int Bytes=Buffer.Deserialize(&Reader);
+       if( (Bytes>0) && (Bytes==(int)(3*sizeof(int32_t)+3*sizeof(double)+Buffer.Full)) )
+       { Buffer.Time+=Buffer.Date; Buffer.Date=0;               // RF_Acq keeps the full time in Time
+         Slots++; return Buffer.Samples(); }
+     }                                                          // corrupted or truncated record: hunt for the next Sync
+   }
+
+   const char *getName(void) const { return FileName; }
+   int isCorrected(void) const { return 1; }                   // the recorder saves the slots after the correction
+
+} ;
+
+// ==================================================================================================
+// Synthetic RF scenario: time slots of noise with a known number of signals added, for load tests
+// and to tune the filter thresholds against a ground truth without hardware. The content is repeatable
+// for a given Seed. Per second it produces one OGN time slot (at SlotStart after the full second,
+// tuned like RF_Acq with FreqPlan::getCenterFrequency()) and every 30 seconds, when GSM_CenterFreq
+// is set, a GSM slot right after it.
+//  - noise:   approx. Gaussian (sum of four uniform bytes) of NoiseLevel rms per I and Q
+//  - bursts:  OGN/FLARM-like GFSK (100 kchip/s, +/-50 kHz, BT=0.5) on the hopping channels of the Plan
+//  - FCCH:    GSM frequency correction bursts = pure tone 67.7 kHz above every GSM carrier
+//  - pulses:  radar-like wideband pulses of 1-2 samples
+//  - CW:      continuous carriers at random (but fixed) offsets from the center
+// All signal frequencies are shifted by FreqError [ppm], which is what the GSM calibration should find.
+
+class SyntheticSource : public SampleSource
+{ public:
+   int      SampleRate;                                        // [Hz]
+   int      SlotSamples;                                       // [samples] per OGN slot
+   double   SlotStart;                                         // [sec] OGN slot start after the full second
+   int      GSM_Samples;                                       // [samples] per GSM slot
+   int      GSM_CenterFreq;                                    // [Hz] 0 = no GSM slots
+   uint32_t StartTime;                                         // [sec] time of the first slot, 0 = now
+   FreqPlan Plan;                                              // hopping plan for the bursts
+   uint32_t Band;                                              // [Hz] tuning band for Plan.getCenterFrequency()
+   double   FreqError;                                         // [ppm] receiver frequency error
+
+   float    NoiseLevel;                                        // [ADC units] noise rms per I and Q
+   float    BurstRate;                                         // [bursts/sec] average number of GFSK bursts
+   float    BurstSNR;                                          // [dB] burst amplitude relative to the noise rms
+   float    PulseRate;                                         // [pulses/sec] average number of radar pulses
+   float    PulseSNR;                                          // [dB]
+   int      GSM_Carriers;                                      // number of GSM carriers with FCCH bursts in the GSM slot
+   float    GSM_SNR;                                           // [dB]
+   int      CW_Carriers;                                       // number of CW carriers
+   float    CW_SNR;                                            // [dB]
+   uint32_t Seed;                                              // random generator seed
+
+   uint32_t Bursts, Pulses, FCCH, OutOfBand;                   // ground truth: signals generated so far
+   int      Slots;
+
+  private:
+   uint32_t Rand;                                              // xorshift random generator state
+   uint32_t SlotSec;                                           // [sec] the next slot
+   int      GSM_Next;                                          // [bool] the next slot is the GSM one
+   static const int MaxCW = 16;
+   float    CW_Freq[MaxCW];                                    // [Hz] offsets of the CW carriers from the center
+   float   *Accum;                                             // I/Q accumulator for one slot
+   int      AccumSize;                                         // [samples]
+   char     Name[64];
+
+  public:
+   SyntheticSource()
+   { SampleRate=1000000; SlotSamples=850000; SlotStart=0.375; GSM_Samples=250000; GSM_CenterFreq=0;
+     StartTime=0; Plan.setPlan(0); Band=850000; FreqError=0;
+     NoiseLevel=4.0; BurstRate=10; BurstSNR=10; PulseRate=0; PulseSNR=20;
+     GSM_Carriers=2; GSM_SNR=20; CW_Carriers=0; CW_SNR=10; Seed=1;
+     Accum=0; AccumSize=0; Name[0]=0; Clear(); }
+
+  ~SyntheticSource() { free(Accum); }
+
+   void Clear(void) { Bursts=0; Pulses=0; FCCH=0; OutOfBand=0; Slots=0; }
+
+   int Open(void)
+   { Clear(); Rand=Seed?Seed:1; GSM_Next=0;
+     SlotSec = StartTime ? StartTime : (uint32_t)time(0);
+     if(CW_Carriers>MaxCW) CW_Carriers=MaxCW;
+     for(int Idx=0; Idx<CW_Carriers; Idx++)
+       CW_Freq[Idx] = (getUniform()-0.5f)*0.9f*SampleRate;
+     snprintf(Name, 64, "synthetic %3.1f Msps", 1e-6*SampleRate);
+     return 0; }
+
+   void Close(void) { }
+
+   int Read(SampleBuffer<uint8_t> &Buffer)
+   { int Samples = GSM_Next ? GSM_Samples:SlotSamples;
+     if(Buffer.Allocate(2, Samples)<=0) return -1;
+     if(AccumSize<Samples)
+     { float *New=(float *)realloc(Accum, 2*Samples*sizeof(float)); if(New==0) return -1;
+       Accum=New; AccumSize=Samples; }
+     Buffer.Rate=SampleRate; Buffer.Date=0;
+     double Scale = 1.0+1e-6*FreqError;                        // the receiver thinks it is at Freq, but is at Freq*Scale
+     if(GSM_Next)
+     { Buffer.Time = SlotSec + SlotStart + (double)SlotSamples/SampleRate + 0.025;
+       Buffer.Freq = GSM_CenterFreq;
+       memset(Accum, 0, 2*Samples*sizeof(float));
+       addFCCH(Samples, Buffer.Time, Buffer.Freq*Scale);
+       GSM_Next=0; SlotSec++; }
+     else
+     { Buffer.Time = SlotSec + SlotStart;
+       Buffer.Freq = Plan.getCenterFrequency(SlotSec, Band);
+       memset(Accum, 0, 2*Samples*sizeof(float));
+       addCW(Samples);
+       addBursts(Samples, Buffer.Time, Buffer.Freq*Scale, Scale);
+       addPulses(Samples);
+       if( (GSM_CenterFreq>0) && ((SlotSec%30)==0) ) GSM_Next=1;
+                                                else SlotSec++; }
+     Convert(Buffer.Data, Samples);
+     Buffer.Full=2*Samples; Buffer.Len=2;
+     Slots++; return Samples; }
+
+   const char *getName(void) const { return Name; }
+
+   int getStatus(char *Line, int MaxLen) const
+   { return snprintf(Line, MaxLen, "%d slots: %d bursts (%d out of band), %d pulses, %d FCCH",
+                     Slots, Bursts, OutOfBand, Pulses, FCCH); }
+
+  private:
+   uint32_t getRandom(void) { Rand^=Rand<<13; Rand^=Rand>>17; Rand^=Rand<<5; return Rand; }
+   float getUniform(void) { return (getRandom()>>8)*(1.0f/16777216); }                  // [0..1)
+   int getPoisson(float Mean)                                                           // number of events for given average
+   { float Limit=expf(-Mean), Prod=getUniform(); int Count=0;
+     while( (Prod>Limit) && (Count<1000) ) { Prod*=getUniform(); Count++; }
+     return Count; }
+
+   float getAmpl(float SNR) const { return NoiseLevel*powf(10.0f, 0.05f*SNR); }
+
+   void addTone(int Start, int Len, float Freq, float Ampl, float Phase=0)               // add a CW tone over the given range
+   { double Step=2*M_PI*Freq/SampleRate;
+     float *Data=Accum+2*Start;
+     for(int Idx=0; Idx<Len; Idx++)
+     { double Ph=Phase+Step*Idx;
+       Data[2*Idx  ] += Ampl*cos(Ph);
+       Data[2*Idx+1] += Ampl*sin(Ph); }
+   }
+
+   void addCW(int Samples)
+   { for(int Idx=0; Idx<CW_Carriers; Idx++)
+       addTone(0, Samples, CW_Freq[Idx], getAmpl(CW_SNR), 2*M_PI*getUniform()); }
+
+   void addBursts(int Samples, double Time, double CenterFreq, double Scale)
+   { int Count=getPoisson(BurstRate);
+     for(int Idx=0; Idx<Count; Idx++)
+     { int Slot=getRandom()&1, OGN=(getRandom()>>1)&1;
+       double BurstTime = SlotSec + 0.4 + 0.4*Slot + 0.395*getUniform();                 // FLARM/OGN slots: 0.4-0.8 and 0.8-1.2 sec
+       int Start = (int)floor((BurstTime-Time)*SampleRate);
+       double Freq = Plan.getFrequency(SlotSec, Slot, OGN)*Scale - CenterFreq;
+       int Len = addGFSK(Start, Samples, Freq, getAmpl(BurstSNR));
+       if(Len>0) Bursts++; else OutOfBand++; }
+   }
+
+   int addGFSK(int Start, int Samples, double Freq, float Ampl)                          // OGN-like packet: preamble, sync, Manchester coded data
+   { const int Chips = 2*(8+32+26*8);                                                   // [chips]
+     const int ChipRate = 100000;                                                       // [chips/sec]
+     const float Dev = 50000;                                                           // [Hz]
+     int SampPerChip = SampleRate/ChipRate; if(SampPerChip<1) return 0;
+     int Len = Chips*SampPerChip;
+     if( (Start<0) || ((Start+Len)>Samples) ) return 0;
+     if( fabs(Freq)>(0.5*SampleRate-2*Dev) ) return 0;
+     int8_t Chip[Chips];                                                                // frequency deviation sign per chip
+     uint32_t Bits=0; int BitsLeft=0;
+     for(int Idx=0; Idx<Chips; Idx+=2)                                                  // Manchester: every bit is two opposite chips
+     { int Bit;
+       if(Idx<16) Bit=(Idx>>1)&1;                                                       // preamble
+       else { if(BitsLeft==0) { Bits=getRandom(); BitsLeft=32; } Bit=Bits&1; Bits>>=1; BitsLeft--; }
+       Chip[Idx]=Bit?1:(-1); Chip[Idx+1]=(-Chip[Idx]); }
+     const int MaxRadius = 32;
+     float Sigma = 0.265f*SampPerChip;                                                  // Gaussian filter for BT=0.5
+     int Radius = (int)ceilf(3*Sigma); if(Radius>MaxRadius) Radius=MaxRadius;
+     float Kernel[2*MaxRadius+1]; float Sum=0;
+     for(int Idx=(-Radius); Idx<=Radius; Idx++) { Kernel[Idx+Radius]=expf(-0.5f*Idx*Idx/(Sigma*Sigma)); Sum+=Kernel[Idx+Radius]; }
+     for(int Idx=0; Idx<=(2*Radius); Idx++) Kernel[Idx]/=Sum;
+     double Phase=2*M_PI*getUniform();
+     float *Data=Accum+2*Start;
+     for(int Idx=0; Idx<Len; Idx++)
+     { float Shape=0;                                                                  // Gaussian filtered chips
+       for(int K=(-Radius); K<=Radius; K++)
+       { int ChipIdx=(Idx+K)/SampPerChip; if( (Idx+K<0) || (ChipIdx>=Chips) ) continue;
+         Shape+=Kernel[K+Radius]*Chip[ChipIdx]; }
+       Phase += 2*M_PI*(Freq+Dev*Shape)/SampleRate;
+       Data[2*Idx  ] += Ampl*cos(Phase);
+       Data[2*Idx+1] += Ampl*sin(Phase); }
+     return Len; }
+
+   void addPulses(int Samples)
+   { float Duration=(float)Samples/SampleRate;
+     int Count=getPoisson(PulseRate*Duration);
+     float Ampl=getAmpl(PulseSNR);
+     for(int Idx=0; Idx<Count; Idx++)
+     { int Pos = 2+(int)(getUniform()*(Samples-4));
+       int Len = 1+(getRandom()&1);
+       float Phase=2*M_PI*getUniform();
+       for(int Samp=0; Samp<Len; Samp++)
+       { Accum[2*(Pos+Samp)  ] += Ampl*cosf(Phase);
+         Accum[2*(Pos+Samp)+1] += Ampl*sinf(Phase); }
+       Pulses++; }
+   }
+
+   void addFCCH(int Samples, double Time, double CenterFreq)                            // FCCH bursts on the GSM carriers around the center
+   { const int    ChanWidth = 200000;                                                   // [Hz]
+     const double ToneOfs   = 1625000.0/24;                                             // [Hz] FCCH tone = 67.708 kHz above the carrier
+     const double Frame     = 120e-3/26;                                                // [sec] TDMA frame
+     const double Burst     = 148*48e-6/13;                                             // [sec] FCCH burst: 148 bits
+     int FirstChan = (int)ceil((CenterFreq-0.4*SampleRate)/ChanWidth);
+     int BurstLen  = (int)floor(Burst*SampleRate);
+     for(int Chan=0; Chan<GSM_Carriers; Chan++)
+     { double Freq = ((double)(FirstChan+Chan)*ChanWidth + ToneOfs) - CenterFreq;
+       if(Freq>=(0.45*SampleRate)) break;
+       double Start = getUniform()*10*Frame;                                            // FCCH every 10 TDMA frames
+       for( ; ; Start+=10*Frame)
+       { int Pos=(int)floor(Start*SampleRate); if((Pos+BurstLen)>Samples) break;
+         addTone(Pos, BurstLen, Freq, getAmpl(GSM_SNR), 2*M_PI*getUniform());
+         FCCH++; }
+     }
+   }
+
+   void Convert(uint8_t *Data, int Samples)                                             // add the noise, quantize to 8-bit with 127.5 bias
+   { const float NoiseScale = NoiseLevel/147.8f;                                        // rms of a sum of four uniform bytes is 147.8
+     for(int Idx=0; Idx<(2*Samples); Idx++)
+     { uint32_t Rnd=getRandom();
+       int Sum = (Rnd&0xFF) + ((Rnd>>8)&0xFF) + ((Rnd>>16)&0xFF) + (Rnd>>24);
+       float Val = 127.5f + Accum[Idx] + NoiseScale*(Sum-510);
+       int Int = (int)floorf(Val); if(Int<0) Int=0; else if(Int>255) Int=255;
+       Data[Idx]=Int; }
+   }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __SAMPLESOURCE_H__
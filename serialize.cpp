@@ -1,9 +1,40 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
+#include <sys/uio.h>
 
 #include "serialize.h"
 
+int Serialize_WriteAll(int Stream, const void *Data, int Bytes)                                  // a pipe or socket can take less than asked
+{ const uint8_t *Ptr=(const uint8_t *)Data; int Left=Bytes;
+  while(Left>0)
+  { int Ret=write(Stream, Ptr, Left);
+    if(Ret<0) { if(errno==EINTR) continue; return -1; }
+    if(Ret==0) return -1;
+    Ptr+=Ret; Left-=Ret; }
+  return Bytes; }
+
+int Serialize_WriteVector(int Stream, struct iovec *Vec, int Count)                              // writev() and continue after short writes
+{ int Total=0;
+  while(Count>0)
+  { int Ret=writev(Stream, Vec, Count);
+    if(Ret<0) { if(errno==EINTR) continue; return -1; }
+    if(Ret==0) return -1;
+    Total+=Ret;
+    while( (Count>0) && ((size_t)Ret>=Vec->iov_len) ) { Ret-=Vec->iov_len; Vec++; Count--; }   // skip the parts written completely
+    if(Count>0) { Vec->iov_base=(uint8_t *)Vec->iov_base+Ret; Vec->iov_len-=Ret; } }             // and the written part of the next one
+  return Total; }
+
+int Serialize_ReadAll(int Stream, void *Data, int Bytes)
+{ uint8_t *Ptr=(uint8_t *)Data; int Total=0;
+  while(Total<Bytes)
+  { int Ret=read(Stream, Ptr+Total, Bytes-Total);
+    if(Ret<0) { if(errno==EINTR) continue; return Total ? Total:-1; }
+    if(Ret==0) break;
+    Total+=Ret; }
+  return Total; }
+
 int Serialize_FindSync(int Stream, uint32_t Sync)                                                // find the Sync word in the stream
 { uint32_t Buffer=0; if(read(Stream, &Buffer, sizeof(uint32_t))!=sizeof(uint32_t)) return -1;    // read the very first word
   if(Buffer==Sync) return 0;                                                                     // if this is our Sync then we are there !
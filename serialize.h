@@ -5,17 +5,176 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/uio.h>
 
-inline int Serialize_WriteSync(int Stream, uint32_t Sync)               { return write(Stream, &Sync, sizeof(uint32_t)); }
-inline int Serialize_WriteName(int Stream, const char *Name)            { return write(Stream, Name, strlen(Name)+1); }
-inline int Serialize_WriteData(int Stream, const void *Data, int Bytes) { return write(Stream, Data, Bytes); }
-inline int Serialize_ReadData (int Stream, void *Data, int Bytes)       { return read (Stream, Data, Bytes); }
+const int Serialize_MaxRecord = 1<<28;                                             // [bytes] larger records are taken for corrupted data
+
+int Serialize_WriteAll(int Stream, const void *Data, int Bytes);                   // write() until all is written or an error
+int Serialize_WriteVector(int Stream, struct iovec *Vec, int Count);               // the same for writev(): Vec[] is modified
+
+inline int Serialize_WriteSync(int Stream, uint32_t Sync)               { return Serialize_WriteAll(Stream, &Sync, sizeof(uint32_t)); }
+inline int Serialize_WriteName(int Stream, const char *Name)            { return Serialize_WriteAll(Stream, Name, strlen(Name)+1); }
+inline int Serialize_WriteData(int Stream, const void *Data, int Bytes) { return Serialize_WriteAll(Stream, Data, Bytes); }
+int Serialize_ReadAll(int Stream, void *Data, int Bytes);                          // read() until all is read: less only at the end of data
+
+inline int Serialize_ReadData (int Stream, void *Data, int Bytes)       { return Serialize_ReadAll(Stream, Data, Bytes); }
 
 inline int Serialize_WriteSync(FILE *Stream, uint32_t Sync)               { return fwrite(&Sync, 1, sizeof(uint32_t), Stream); }
 inline int Serialize_WriteName(FILE *Stream, const char *Name)            { return fwrite(Name,  1, strlen(Name)+1,   Stream); }
 inline int Serialize_WriteData(FILE *Stream, const void *Data, int Bytes) { return fwrite(Data,  1, Bytes,            Stream); }
 inline int Serialize_ReadData (FILE *Stream, void *Data, int Bytes)       { return fread (Data,  1, Bytes,            Stream); }
 
+// collects a record to be written with a single writev(): the small fields are copied into one contiguous block,
+// the large data is only referenced, thus it has to stay in place until Write()
+class Serialize_Gather
+{ public:
+   static const int MaxVec  = 16;
+   static const int MaxCopy = 512;  // [bytes] for the small fields
+   static const int MinRef  = 256;  // [bytes] data blocks this large and larger are referenced, not copied
+
+   uint8_t      Copy[MaxCopy];
+   int          CopyLen;
+   struct iovec Vec[MaxVec];
+   int          Count;
+
+  public:
+   Serialize_Gather() { Clear(); }
+
+   void Clear(void) { CopyLen=0; Count=0; }
+
+   int Add(const void *Data, int Bytes)
+   { if(Bytes<MinRef)                                   // small fields can be temporaries: never reference them
+     { if((CopyLen+Bytes)>MaxCopy) return -1;
+       uint8_t *Dst=Copy+CopyLen; memcpy(Dst, Data, Bytes); CopyLen+=Bytes;
+       if( Count && ((uint8_t *)Vec[Count-1].iov_base+Vec[Count-1].iov_len==Dst) ) { Vec[Count-1].iov_len+=Bytes; return Bytes; }
+       Data=Dst; }
+     if(Count>=MaxVec) return -1;
+     Vec[Count].iov_base=(void *)Data; Vec[Count].iov_len=Bytes; Count++;
+     return Bytes; }
+
+   int Write(int Stream)            // returns the number of bytes written or -1
+   { int Ret=Serialize_WriteVector(Stream, Vec, Count); Clear(); return Ret; }
+} ;
+
+inline int Serialize_WriteSync(Serialize_Gather *Stream, uint32_t Sync)               { return Stream->Add(&Sync, sizeof(uint32_t)); }
+inline int Serialize_WriteName(Serialize_Gather *Stream, const char *Name)            { return Stream->Add(Name, strlen(Name)+1); }
+inline int Serialize_WriteData(Serialize_Gather *Stream, const void *Data, int Bytes) { return Stream->Add(Data, Bytes); }
+
+// buffered reading of a serialized stream (pipe, socket or file) with few large read() calls:
+// records can be used in place with Get() - valid until the next call which reads from the stream,
+// and Serialize_FindSync() scans the buffer with memchr() rather than reading byte by byte
+class Serialize_Reader
+{ public:
+   int      Stream;                 // file descriptor
+   uint8_t *Buffer;
+   int      Size;                   // [bytes] allocated, grows when a record is larger
+   int      Start, End;             // data in the buffer: Buffer[Start..End-1]
+   int      Eof;                    // [bool] end of the stream or a read error
+   uint64_t Position;               // [bytes] consumed so far
+
+  public:
+   Serialize_Reader(int Stream=(-1), int Size=1<<20) { Buffer=0; this->Size=0; Open(Stream, Size); }
+  ~Serialize_Reader() { free(Buffer); }
+
+   void Open(int Stream, int Size=1<<20)   // the reader does not close the stream
+   { this->Stream=Stream; Reset();
+     if(Size>this->Size) Resize(Size); }
+
+   void Reset(void) { Start=0; End=0; Eof=0; Position=0; } // e.g. after lseek() on the stream
+
+   int Available(void) const { return End-Start; }
+
+   int Fill(int Bytes)              // make Bytes available in the buffer: returns what is available (less only at the end of data or above Serialize_MaxRecord)
+   { if(Available()>=Bytes) return Available();
+     if(Start>0)                                   // move the remaining data to the front
+     { int Len=Available(); if(Len) memmove(Buffer, Buffer+Start, Len); Start=0; End=Len; }
+     if( (Bytes>Size) && (Resize(Bytes)<0) ) Bytes=Size;          // too large: fill what fits
+     while( (Available()<Bytes) && (!Eof) )
+     { int Ret=read(Stream, Buffer+End, Size-End);  // read as much as there is, not just what was asked
+       if(Ret<0) { if(errno==EINTR) continue; Eof=1; break; }
+       if(Ret==0) { Eof=1; break; }
+       End+=Ret; }
+     return Available(); }
+
+   const void *Peek(int Bytes)      // Bytes in place (not consumed) or 0 when the stream ends before
+   { if(Bytes<0) return 0;
+     if(Fill(Bytes)<Bytes) return 0;
+     return Buffer+Start; }
+
+   const void *Get(int Bytes)       // Bytes in place and consumed
+   { const void *Ptr=Peek(Bytes); if(Ptr==0) return 0;
+     Start+=Bytes; Position+=Bytes; return Ptr; }
+
+   const void *GetAligned(int Bytes, int Align=16) // the same, aligned for SIMD: the data is moved to the front of the buffer if need be
+   { if(Bytes<0) return 0;
+     if(Fill(Bytes)<Bytes) return 0;
+     if((uintptr_t)(Buffer+Start)%Align) { int Len=Available(); memmove(Buffer, Buffer+Start, Len); Start=0; End=Len; }
+     return Get(Bytes); }
+
+   int Read(void *Data, int Bytes)  // copy out: returns the number of bytes, less only at the end of data
+   { if(Bytes<=0) return 0;
+     int Len=Available(); if(Len>Bytes) Len=Bytes;
+     memcpy(Data, Buffer+Start, Len); Start+=Len; Position+=Len;
+     if(Len==Bytes) return Len;
+     if(Bytes-Len>=Size)                            // large: straight into Data, the buffer does not grow
+     { int Ret=Serialize_ReadAll(Stream, (uint8_t *)Data+Len, Bytes-Len);
+       if(Ret<Bytes-Len) Eof=1;
+       if(Ret>0) { Len+=Ret; Position+=Ret; }
+       return Len; }
+     int More=Fill(Bytes-Len); if(More>Bytes-Len) More=Bytes-Len;
+     memcpy((uint8_t *)Data+Len, Buffer+Start, More); Start+=More; Position+=More;
+     return Len+More; }
+
+   void Skip(uint64_t Bytes)        // consume Bytes: beyond the buffered data with lseek() when the stream allows it
+   { uint64_t Len=Available(); if(Len>Bytes) Len=Bytes;
+     Start+=Len; Position+=Len; Bytes-=Len;
+     if(Bytes==0) return;
+     if(lseek(Stream, Bytes, SEEK_CUR)>=0) { Position+=Bytes; return; }
+     while( (Bytes>0) && (Fill(1)>0) )                    // a pipe or socket: read and drop
+     { Len=Available(); if(Len>Bytes) Len=Bytes;
+       Start+=Len; Position+=Len; Bytes-=Len; }
+   }
+
+   int FindSync(uint32_t Sync)      // skip to just after the next Sync word: number of bytes skipped or -1 at the end of data
+   { const uint8_t First=Sync&0xFF; int Total=0;
+     for( ; ; )
+     { if(Fill(sizeof(uint32_t))<(int)sizeof(uint32_t)) return -1;
+       const uint8_t *Ptr=Buffer+Start;
+       const uint8_t *Last=Buffer+End-sizeof(uint32_t);              // the last position where a whole word fits
+       while(Ptr<=Last)
+       { Ptr=(const uint8_t *)memchr(Ptr, First, Last-Ptr+1); if(Ptr==0) break;
+         if(memcmp(Ptr, &Sync, sizeof(uint32_t))==0)
+         { int Skip=Ptr-(Buffer+Start); Total+=Skip; Skip+=sizeof(uint32_t);
+           Start+=Skip; Position+=Skip; return Total; }
+         Ptr++; }
+       int Skip=Available()-(sizeof(uint32_t)-1);                    // keep the last three bytes: a Sync can start there
+       Total+=Skip; Start+=Skip; Position+=Skip;
+       if(Fill(Available()+1)<=(int)sizeof(uint32_t)-1) return -1; }
+   }
+
+   int ReadName(char *Name, int MaxBytes) // a null-terminated name: its length or -1
+   { int Len=Fill(MaxBytes); if(Len>MaxBytes) Len=MaxBytes;
+     const uint8_t *Zero=(const uint8_t *)memchr(Buffer+Start, 0, Len); if(Zero==0) return -1;
+     Len=Zero-(Buffer+Start);
+     memcpy(Name, Buffer+Start, Len+1); Start+=Len+1; Position+=Len+1; return Len; }
+
+  private:
+   int Resize(int NewSize)
+   { if( (NewSize<0) || (NewSize>Serialize_MaxRecord) ) return -1;
+     size_t Alloc=4096; while(Alloc<(size_t)NewSize) Alloc*=2;
+     void *NewBuffer=0; if(posix_memalign(&NewBuffer, 64, Alloc)!=0) return -1; // aligned, unlike realloc()
+     if(End>Start) memcpy((uint8_t *)NewBuffer, Buffer+Start, End-Start);
+     End-=Start; Start=0;
+     free(Buffer); Buffer=(uint8_t *)NewBuffer; Size=Alloc; return Size; }
+
+} ;
+
+inline int Serialize_ReadData(Serialize_Reader *Stream, void *Data, int Bytes)        { return Stream->Read(Data, Bytes); }
+inline int Serialize_FindSync(Serialize_Reader *Stream, uint32_t Sync)                { return Stream->FindSync(Sync); }
+inline int Serialize_ReadName(Serialize_Reader *Stream, char *Name, int MaxBytes)     { return Stream->ReadName(Name, MaxBytes); }
+
 int Serialize_FindSync(int Stream, uint32_t Sync);
 int Serialize_ReadName(int Stream, char *Name, int MaxBytes);
 
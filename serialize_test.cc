@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "serialize.h"
+#include "buffer.h"
+
+static const uint32_t Sync = 0x254F7D01;
+
+static int OpenTemp(const uint8_t *Data, int Bytes)                 // a file with the given content, positioned at the start
+{ char Name[] = "/tmp/serialize_test.XXXXXX";
+  int File=mkstemp(Name); if(File<0) return -1;
+  unlink(Name);
+  if(Serialize_WriteAll(File, Data, Bytes)!=Bytes) { close(File); return -1; }
+  lseek(File, 0, SEEK_SET); return File; }
+
+static int PutHeader(uint8_t *Out, int32_t Size, int32_t Full, int32_t Len) // Sync and a SampleBuffer header
+{ double Rate=2e6, Time=1000.5, Freq=868.8e6;
+  memcpy(Out, &Sync, 4);
+  memcpy(Out+4, &Size, 4); memcpy(Out+8, &Full, 4); memcpy(Out+12, &Len, 4);
+  memcpy(Out+16, &Rate, 8); memcpy(Out+24, &Time, 8); memcpy(Out+32, &Freq, 8);
+  return 40; }
+
+static int TestSplitSync(void)                                      // Sync word across a buffer refill
+{ const int Junk=4094, Samples=64;
+  uint8_t Data[Junk+40+Samples];
+  memset(Data, 0x55, Junk);
+  int Len=Junk+PutHeader(Data+Junk, Samples, Samples, 2);
+  for(int Idx=0; Idx<Samples; Idx++) Data[Len++]=Idx;
+  int File=OpenTemp(Data, Len); if(File<0) return 1;
+  Serialize_Reader Reader(File, 4096);
+  int Errors=0;
+  int Skipped=Reader.FindSync(Sync);
+  if(Skipped!=Junk) { printf("SplitSync: skipped %d instead of %d\n", Skipped, Junk); Errors++; }
+  SampleBuffer<uint8_t> Buffer;
+  const uint8_t *Ptr=Buffer.DeserializeInPlace(&Reader);
+  if( (Ptr==0) || (Buffer.Full!=Samples) || (Ptr[Samples-1]!=Samples-1) ) { printf("SplitSync: record not read\n"); Errors++; }
+  close(File);
+  printf("SplitSync: %d errors\n", Errors); return Errors; }
+
+static int TestTruncated(void)                                      // the data ends before the record does
+{ uint8_t Data[40+100];
+  int Len=PutHeader(Data, 1000, 1000, 2);
+  memset(Data+Len, 0, 100); Len+=100;
+  int Errors=0;
+  int File=OpenTemp(Data, Len); if(File<0) return 1;
+  Serialize_Reader Reader(File, 4096);
+  SampleBuffer<uint8_t> Buffer;
+  if(Reader.FindSync(Sync)!=0) Errors++;
+  if(Buffer.DeserializeInPlace(&Reader)!=0) { printf("Truncated: DeserializeInPlace() accepted the record\n"); Errors++; }
+  lseek(File, 0, SEEK_SET); Reader.Reset();
+  if(Reader.FindSync(Sync)!=0) Errors++;
+  int Ret=Buffer.Deserialize(&Reader);
+  if(Ret!=40-4+100) { printf("Truncated: Deserialize() returned %d\n", Ret); Errors++; }
+  close(File);
+  printf("Truncated: %d errors\n", Errors); return Errors; }
+
+static int TestHugeFull(void)                                       // a corrupted header must not hang or allocate gigabytes
+{ uint8_t Data[40+256];
+  int Len=PutHeader(Data, 0x7FFFFFF0, 0x7FFFFFF0, 2);
+  memset(Data+Len, 0, 256); Len+=256;
+  int Errors=0;
+  int File=OpenTemp(Data, Len); if(File<0) return 1;
+  Serialize_Reader Reader(File, 4096);
+  SampleBuffer<uint8_t> Buffer;
+  if(Reader.FindSync(Sync)!=0) Errors++;
+  if(Buffer.DeserializeInPlace(&Reader)!=0) { printf("HugeFull: DeserializeInPlace() accepted the record\n"); Errors++; }
+  lseek(File, 0, SEEK_SET); Reader.Reset();
+  if(Reader.FindSync(Sync)!=0) Errors++;
+  if(Buffer.Deserialize(&Reader)>=0) { printf("HugeFull: Deserialize() accepted the record\n"); Errors++; }
+  lseek(File, 0, SEEK_SET); Reader.Reset();
+  if(Reader.Fill(0x7FFFFFF0)!=Len) { printf("HugeFull: Fill() did not stop at the end of data\n"); Errors++; }
+  if(Reader.Size>Serialize_MaxRecord) { printf("HugeFull: buffer grew to %d bytes\n", Reader.Size); Errors++; }
+  close(File);
+  printf("HugeFull: %d errors\n", Errors); return Errors; }
+
+static int TestGatherFull(void)                                     // small fields which do not fit must be refused, not referenced
+{ Serialize_Gather Gather;
+  uint8_t Field[200]; memset(Field, 0xAA, sizeof(Field));
+  int Errors=0;
+  if(Gather.Add(Field, sizeof(Field))!=sizeof(Field)) Errors++;
+  if(Gather.Add(Field, sizeof(Field))!=sizeof(Field)) Errors++;
+  if(Gather.Add(Field, sizeof(Field))>=0) { printf("GatherFull: Add() accepted a field beyond the copy space\n"); Errors++; }
+  for(int Idx=0; Idx<Gather.Count; Idx++)
+  { const uint8_t *Base=(const uint8_t *)Gather.Vec[Idx].iov_base;
+    if( (Base<Gather.Copy) || (Base>=Gather.Copy+Serialize_Gather::MaxCopy) ) { printf("GatherFull: a small field is referenced\n"); Errors++; } }
+  printf("GatherFull: %d errors\n", Errors); return Errors; }
+
+int main(int argc, char *argv[])
+{ int Errors=0;
+  Errors+=TestSplitSync();
+  Errors+=TestTruncated();
+  Errors+=TestHugeFull();
+  Errors+=TestGatherFull();
+  return Errors!=0; }
@@ -0,0 +1,201 @@
+#ifndef __SHMRING_H__
+#define __SHMRING_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+// ==================================================================================================
+// Shared memory ring of time slots (spectra) for the decoders on the same machine: the writer copies
+// every slot once into the ring, the readers use it in place, without going through a pipe or socket.
+// The ring is a POSIX shared memory object (/dev/shm/<Name>): a header page followed by Records
+// records of RecordSize bytes, each one a ShmRing_Record followed by the data. The writer never waits
+// for the readers: a reader which is too slow loses the oldest slots, and as the data is used in place
+// it has to check with Valid() after processing that the record has not been overwritten meanwhile.
+// Records are guarded by their sequence number (seqlock): odd while being written, even when complete.
+// The readers sleep on a futex in the header, which the writer increments with every record.
+
+struct ShmRing_Header              // at the start of the shared memory
+{ uint32_t Magic;                  // ShmRing_Magic
+  uint32_t Version;
+  uint32_t Sync;                   // type of the data, same as the pipe sync word, e.g. 0x254F7D00+sizeof(Float)
+  uint32_t Records;                // number of records in the ring
+  uint32_t RecordSize;             // [bytes] including ShmRing_Record, a multiple of the page size
+  uint32_t DataOffset;             // [bytes] from the start of a record to the data
+  volatile uint32_t Closed;        // [bool] the writer closed (or recreated) the ring: the readers have to reopen
+  volatile uint32_t Doorbell;      // futex: incremented for every record written
+  volatile uint64_t Written;       // number of records written
+} ;
+
+struct ShmRing_Record              // at the start of every record
+{ volatile uint64_t Seq;           // 2*Index+1 while being written, 2*Index+2 when complete (Index = record number)
+  int32_t  FreqCorr;               // [ppm] same fields as written to the pipe
+  float    GSM_FreqCorr;           // [ppm]
+  int32_t  Size, Full, Len;        // SampleBuffer header
+  double   Rate;                   // [Hz]
+  double   Time;                   // [sec]
+  double   Freq;                   // [Hz]
+  uint32_t Bytes;                  // [bytes] data in this record
+} ;
+
+const uint32_t ShmRing_Magic   = 0x4F474E52;  // "RNGO"
+const uint32_t ShmRing_Version = 1;
+const int      ShmRing_Page    = 4096;
+
+inline int ShmRing_Map(const char *Name, int Flags, ShmRing_Header *&Header, size_t &MapSize, size_t Size=0)
+{ int File=shm_open(Name, Flags, 0666); if(File<0) return -1;
+  if(Size)
+  { if(ftruncate(File, Size)<0) { close(File); return -1; } }
+  else
+  { struct stat Stat; if(fstat(File, &Stat)<0) { close(File); return -1; }
+    Size=Stat.st_size; if(Size<sizeof(ShmRing_Header)) { close(File); return -1; } }
+  int Prot = (Flags&O_RDWR) ? PROT_READ|PROT_WRITE : PROT_READ;
+  void *Ptr=mmap(0, Size, Prot, MAP_SHARED, File, 0); close(File);
+  if(Ptr==MAP_FAILED) return -1;
+  Header=(ShmRing_Header *)Ptr; MapSize=Size; return 0; }
+
+class ShmRingWriter
+{ public:
+   char            Name[64];        // shared memory object name, starts with '/'
+   int             Records;         // number of records in the ring
+   ShmRing_Header *Header;
+   size_t          MapSize;
+   uint64_t        Index;           // of the record being written
+
+  public:
+   ShmRingWriter() { Name[0]=0; Records=4; Header=0; MapSize=0; Index=0; }
+  ~ShmRingWriter() { Close(); }
+
+   int isOpen(void) const { return Header!=0; }
+
+   int Open(const char *Name, uint32_t Sync, int DataBytes) // create (or recreate) the ring for records of DataBytes
+   { Close();
+     if(Name[0]=='/') strncpy(this->Name, Name, 63);
+                 else { this->Name[0]='/'; strncpy(this->Name+1, Name, 62); }
+     this->Name[63]=0;
+     int DataOffset = ((sizeof(ShmRing_Record)+63)/64)*64;
+     int RecordSize = ((DataOffset+DataBytes+ShmRing_Page-1)/ShmRing_Page)*ShmRing_Page;
+     if(Records<2) Records=2;
+     shm_unlink(this->Name);
+     if(ShmRing_Map(this->Name, O_RDWR|O_CREAT|O_EXCL, Header, MapSize, ShmRing_Page+(size_t)Records*RecordSize)<0)
+     { printf("ShmRingWriter.Open() ... cannot create %s\n", this->Name); Header=0; return -1; }
+     Header->Sync=Sync; Header->Records=Records; Header->RecordSize=RecordSize; Header->DataOffset=DataOffset;
+     Header->Closed=0; Header->Doorbell=0; Header->Written=0;
+     Header->Version=ShmRing_Version;
+     __atomic_store_n(&Header->Magic, ShmRing_Magic, __ATOMIC_RELEASE);
+     Index=0; return 0; }
+
+   void Close(void)
+   { if(Header==0) return;
+     __atomic_store_n(&Header->Closed, 1, __ATOMIC_RELEASE); Wake();
+     munmap(Header, MapSize); Header=0; MapSize=0;
+     shm_unlink(Name); }
+
+   int DataSize(void) const { return Header ? Header->RecordSize-Header->DataOffset:0; } // [bytes] max. data per record
+
+   ShmRing_Record *Begin(void)                   // the next record to fill: Commit() it when done
+   { ShmRing_Record *Record=getRecord(Index);
+     __atomic_store_n(&Record->Seq, 2*Index+1, __ATOMIC_RELAXED);
+     __atomic_thread_fence(__ATOMIC_RELEASE);
+     return Record; }
+
+   void *Data(ShmRing_Record *Record) const { return (uint8_t *)Record+Header->DataOffset; }
+
+   void Commit(ShmRing_Record *Record)
+   { __atomic_store_n(&Record->Seq, 2*Index+2, __ATOMIC_RELEASE);
+     Index++; __atomic_store_n(&Header->Written, Index, __ATOMIC_RELEASE);
+     Wake(); }
+
+  private:
+   ShmRing_Record *getRecord(uint64_t Idx) const
+   { return (ShmRing_Record *)((uint8_t *)Header+ShmRing_Page+(size_t)(Idx%Header->Records)*Header->RecordSize); }
+
+   void Wake(void)
+   { __atomic_add_fetch(&Header->Doorbell, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+     syscall(SYS_futex, &Header->Doorbell, FUTEX_WAKE, INT_MAX, 0, 0, 0); // not _PRIVATE: the waiters are in other processes
+#endif
+   }
+
+} ;
+
+class ShmRingReader                // to be used by the decoders
+{ public:
+   ShmRing_Header *Header;
+   size_t          MapSize;
+   uint64_t        Next;           // index of the next record to read
+   uint64_t        Lost;           // records overwritten before they were read
+
+  public:
+   ShmRingReader() { Header=0; MapSize=0; Next=0; Lost=0; }
+  ~ShmRingReader() { Close(); }
+
+   int isOpen(void) const { return Header!=0; }
+
+   int Open(const char *Name, uint32_t Sync)     // returns -1 when the ring does not exist (yet) or holds different data
+   { Close();
+     char ShmName[64];
+     if(Name[0]=='/') strncpy(ShmName, Name, 63);
+                 else { ShmName[0]='/'; strncpy(ShmName+1, Name, 62); }
+     ShmName[63]=0;
+     if(ShmRing_Map(ShmName, O_RDONLY, Header, MapSize)<0) { Header=0; return -1; }
+     if( (__atomic_load_n(&Header->Magic, __ATOMIC_ACQUIRE)!=ShmRing_Magic) || (Header->Version!=ShmRing_Version)
+      || (Header->Sync!=Sync) || (MapSize<ShmRing_Page+(size_t)Header->Records*Header->RecordSize) )
+     { Close(); return -1; }
+     Next=__atomic_load_n(&Header->Written, __ATOMIC_ACQUIRE);     // start with the next slot
+     return 0; }
+
+   void Close(void)
+   { if(Header) munmap(Header, MapSize);
+     Header=0; MapSize=0; }
+
+   const ShmRing_Record *Get(int Timeout=1000)   // [ms] wait for the next record: 0 on timeout or when the writer closed the ring
+   { for( ; ; )
+     { if(Header==0) return 0;
+       if(__atomic_load_n(&Header->Closed, __ATOMIC_ACQUIRE)) { Close(); return 0; }
+       uint32_t Bell=__atomic_load_n(&Header->Doorbell, __ATOMIC_SEQ_CST);
+       uint64_t Written=__atomic_load_n(&Header->Written, __ATOMIC_ACQUIRE);
+       if(Written>Next)
+       { if((Written-Next)>Header->Records) { Lost+=Written-Next-1; Next=Written-1; } // too far behind: jump to the newest record
+         const ShmRing_Record *Record=getRecord(Next);
+         if(__atomic_load_n(&Record->Seq, __ATOMIC_ACQUIRE)==2*Next+2) { Next++; return Record; }
+         Lost++; Next++; continue; }                                        // overwritten meanwhile
+       if(Timeout<=0) return 0;
+#ifdef __linux__
+       struct timespec Wait; Wait.tv_sec=Timeout/1000; Wait.tv_nsec=(Timeout%1000)*1000000;
+       syscall(SYS_futex, &Header->Doorbell, FUTEX_WAIT, Bell, &Wait, 0, 0);
+#else
+       usleep(1000*Timeout);
+#endif
+       Timeout=0; }                                                          // one more check after the wait
+   }
+
+   const void *Data(const ShmRing_Record *Record) const { return (const uint8_t *)Record+Header->DataOffset; }
+
+   int Valid(const ShmRing_Record *Record) const // after using the data in place: it has not been overwritten meanwhile
+   { __atomic_thread_fence(__ATOMIC_ACQUIRE);
+     uint64_t Seq=__atomic_load_n(&Record->Seq, __ATOMIC_RELAXED);
+     return Seq==2*(Next-1)+2; }                 // valid for the record returned by the last Get()
+
+  private:
+   const ShmRing_Record *getRecord(uint64_t Idx) const
+   { return (const ShmRing_Record *)((const uint8_t *)Header+ShmRing_Page+(size_t)(Idx%Header->Records)*Header->RecordSize); }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __SHMRING_H__
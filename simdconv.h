@@ -0,0 +1,112 @@
+#ifndef __SIMDCONV_H__
+#define __SIMDCONV_H__
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// ==================================================================================================
+// Conversion of complex 8-bit RTLSDR samples to complex float with the bias removed and a window applied:
+//   Out[2*Idx] = Window[Idx]*(Inp[2*Idx]-Bias), Out[2*Idx+1] = Window[Idx]*(Inp[2*Idx+1]-Bias)
+// This is the inner loop of the sliding FFT on the raw data, thus there are vector versions
+// (SSE2, AVX2, NEON) and ConvertWindow() picks the best one for the CPU at run time.
+// All pointers can be unaligned. The results are identical to the scalar version.
+
+typedef void (*ConvertWindowFunc)(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias);
+
+inline void ConvertWindow_Scalar(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ for(int Idx=0; Idx<Samples; Idx++)
+  { Out[0] = Window[Idx]*(Inp[0]-Bias);
+    Out[1] = Window[Idx]*(Inp[1]-Bias);
+    Inp+=2; Out+=2; }
+}
+
+#if defined(__SSE2__)
+inline void ConvertWindow_SSE2(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ const __m128i Zero = _mm_setzero_si128();
+  const __m128  Bias4 = _mm_set1_ps(Bias);
+  int Idx=0;
+  for( ; Idx<=(Samples-8); Idx+=8)                                   // 8 complex samples = 16 bytes per loop
+  { __m128i Byte  = _mm_loadu_si128((const __m128i *)(Inp+2*Idx));
+    __m128i Word0 = _mm_unpacklo_epi8(Byte, Zero);
+    __m128i Word1 = _mm_unpackhi_epi8(Byte, Zero);
+    __m128  Val0  = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Word0, Zero)), Bias4); // I0 Q0 I1 Q1
+    __m128  Val1  = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Word0, Zero)), Bias4); // I2 Q2 I3 Q3
+    __m128  Val2  = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Word1, Zero)), Bias4);
+    __m128  Val3  = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Word1, Zero)), Bias4);
+    __m128  Win0  = _mm_loadu_ps(Window+Idx);                       // W0 W1 W2 W3
+    __m128  Win1  = _mm_loadu_ps(Window+Idx+4);
+    _mm_storeu_ps(Out+2*Idx   , _mm_mul_ps(Val0, _mm_unpacklo_ps(Win0, Win0)));          // W0 W0 W1 W1
+    _mm_storeu_ps(Out+2*Idx+ 4, _mm_mul_ps(Val1, _mm_unpackhi_ps(Win0, Win0)));
+    _mm_storeu_ps(Out+2*Idx+ 8, _mm_mul_ps(Val2, _mm_unpacklo_ps(Win1, Win1)));
+    _mm_storeu_ps(Out+2*Idx+12, _mm_mul_ps(Val3, _mm_unpackhi_ps(Win1, Win1))); }
+  ConvertWindow_Scalar(Out+2*Idx, Inp+2*Idx, Window+Idx, Samples-Idx, Bias); }
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+__attribute__((target("avx2")))
+inline void ConvertWindow_AVX2(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ const __m256  Bias8 = _mm256_set1_ps(Bias);
+  int Idx=0;
+  for( ; Idx<=(Samples-8); Idx+=8)                                   // 8 complex samples = 16 bytes per loop
+  { __m256 Val0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(Inp+2*Idx  ))));
+    __m256 Val1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(Inp+2*Idx+8))));
+    __m128 Win  = _mm_loadu_ps(Window+Idx);
+    __m128 Win0 = _mm_unpacklo_ps(Win, Win);                        // W0 W0 W1 W1
+    __m128 Win1 = _mm_unpackhi_ps(Win, Win);                        // W2 W2 W3 W3
+    Win  = _mm_loadu_ps(Window+Idx+4);
+    __m128 Win2 = _mm_unpacklo_ps(Win, Win);
+    __m128 Win3 = _mm_unpackhi_ps(Win, Win);
+    _mm256_storeu_ps(Out+2*Idx  , _mm256_mul_ps(_mm256_sub_ps(Val0, Bias8), _mm256_insertf128_ps(_mm256_castps128_ps256(Win0), Win1, 1)));
+    _mm256_storeu_ps(Out+2*Idx+8, _mm256_mul_ps(_mm256_sub_ps(Val1, Bias8), _mm256_insertf128_ps(_mm256_castps128_ps256(Win2), Win3, 1))); }
+  ConvertWindow_Scalar(Out+2*Idx, Inp+2*Idx, Window+Idx, Samples-Idx, Bias); }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+inline void ConvertWindow_NEON(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ const float32x4_t Bias4 = vdupq_n_f32(Bias);
+  int Idx=0;
+  for( ; Idx<=(Samples-8); Idx+=8)                                   // 8 complex samples = 16 bytes per loop
+  { uint8x8x2_t Byte = vld2_u8(Inp+2*Idx);                          // de-interleave: I0..I7 and Q0..Q7
+    uint16x8_t I = vmovl_u8(Byte.val[0]);
+    uint16x8_t Q = vmovl_u8(Byte.val[1]);
+    float32x4_t Win0 = vld1q_f32(Window+Idx);
+    float32x4_t Win1 = vld1q_f32(Window+Idx+4);
+    float32x4x2_t Val;
+    Val.val[0] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(I))), Bias4), Win0);
+    Val.val[1] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(Q))), Bias4), Win0);
+    vst2q_f32(Out+2*Idx, Val);                                      // interleaved store: I0 Q0 I1 Q1 ...
+    Val.val[0] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(I))), Bias4), Win1);
+    Val.val[1] = vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(Q))), Bias4), Win1);
+    vst2q_f32(Out+2*Idx+8, Val); }
+  ConvertWindow_Scalar(Out+2*Idx, Inp+2*Idx, Window+Idx, Samples-Idx, Bias); }
+#endif
+
+inline ConvertWindowFunc ConvertWindow_Select(void)                 // the best version for this CPU
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return ConvertWindow_AVX2;
+#endif
+#if defined(__SSE2__)
+  return ConvertWindow_SSE2;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  return ConvertWindow_NEON;
+#else
+  return ConvertWindow_Scalar;
+#endif
+}
+
+inline void ConvertWindow(float *Out, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ static const ConvertWindowFunc Func = ConvertWindow_Select();      // selected once, at the first call
+  (*Func)(Out, Inp, Window, Samples, Bias); }
+
+// ==================================================================================================
+
+#endif // __SIMDCONV_H__
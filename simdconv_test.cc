@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "simdconv.h"
+
+static double getTime(void)
+{ struct timespec Now; clock_gettime(CLOCK_MONOTONIC, &Now); return Now.tv_sec+1e-9*Now.tv_nsec; }
+
+static int Check(const char *Name, ConvertWindowFunc Func, const uint8_t *Inp, const float *Window, int Samples, float Bias)
+{ float *Ref = (float *)malloc(2*(Samples+8)*sizeof(float));
+  float *Out = (float *)malloc(2*(Samples+8)*sizeof(float));
+  int Errors=0;
+  for(int Ofs=0; Ofs<4; Ofs++)                                          // unaligned input, window and output
+  { for(int Len=Samples-Ofs-9; Len<=(Samples-Ofs); Len++)               // all tail lengths
+    { ConvertWindow_Scalar(Ref+Ofs, Inp+2*Ofs, Window+Ofs, Len, Bias);
+      (*Func)(Out+Ofs, Inp+2*Ofs, Window+Ofs, Len, Bias);
+      for(int Idx=0; Idx<(2*Len); Idx++)
+        if(Out[Ofs+Idx]!=Ref[Ofs+Idx]) Errors++; }
+  }
+  double Start=getTime(); int Loops=2000;
+  for(int Loop=0; Loop<Loops; Loop++) (*Func)(Out, Inp, Window, Samples, Bias);
+  double Time=getTime()-Start;
+  printf("%-8s: %d errors, %6.3f ns/sample\n", Name, Errors, 1e9*Time/Loops/Samples);
+  free(Ref); free(Out);
+  return Errors; }
+
+int main(int argc, char *argv[])
+{ const int Samples = 4096;
+  uint8_t Inp[2*Samples]; float Window[Samples];
+  srand(123456);
+  for(int Idx=0; Idx<(2*Samples); Idx++) Inp[Idx]=rand()&0xFF;
+  for(int Idx=0; Idx<Samples; Idx++) Window[Idx]=(float)rand()/RAND_MAX;
+  float Bias=127.38;
+
+  int Errors=0;
+  Errors+=Check("Scalar", ConvertWindow_Scalar, Inp, Window, Samples, Bias);
+#if defined(__SSE2__)
+  Errors+=Check("SSE2",   ConvertWindow_SSE2,   Inp, Window, Samples, Bias);
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  if(__builtin_cpu_supports("avx2"))
+  Errors+=Check("AVX2",   ConvertWindow_AVX2,   Inp, Window, Samples, Bias);
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  Errors+=Check("NEON",   ConvertWindow_NEON,   Inp, Window, Samples, Bias);
+#endif
+  Errors+=Check("Selected", ConvertWindow_Select(), Inp, Window, Samples, Bias);
+  return Errors!=0; }
@@ -0,0 +1,125 @@
+#ifndef __SPARSESPECTRA_H__
+#define __SPARSESPECTRA_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <complex>
+#include <vector>
+#include <algorithm>
+
+#include "buffer.h"
+#include "serialize.h"
+#include "specenc.h"
+
+// ==================================================================================================
+// Energy-gated (sparse) output of the sliding FFT: the time-frequency plane of a slot is divided into
+// tiles of TileSlides x TileBins, the energy of every tile is compared with the noise floor of its
+// frequency column (running average over slots of the median tile energy) and only the tiles above
+// Threshold - plus Guard tiles around them, so a burst is not cut at the tile edges - are sent,
+// together with the occupancy map and the noise floor. On a quiet site this is a small fraction of
+// the full spectra.
+
+template <class Float>
+ class SparseSpectra
+{ public:
+   int   TileBins;                                  // [bins] tile width
+   int   TileSlides;                                // [slides] tile length
+   Float Threshold;                                 // [dB] tile energy above the noise floor to be sent
+   int   Guard;                                     // [tiles] sent around every tile above the threshold
+   Float Alpha;                                     // weight of the new slot in the running noise floor
+
+   int   Len;                                       // [bins] per slide, of the last slot
+   int   Slides;                                    // [slides] in the last slot
+   int   FreqTiles, TimeTiles;                      // number of tiles of the last slot
+   int   Sent;                                      // number of tiles sent for the last slot
+
+   std::vector<Float>   Energy;                     // [TimeTiles][FreqTiles] tile energy
+   std::vector<Float>   Noise;                      // [FreqTiles] noise floor: median tile energy
+   std::vector<float>   NoiseOut;                   // the same as float for the output
+   std::vector<uint8_t> Map;                        // [TimeTiles][FreqTiles] bits: tile sent
+   SampleBuffer< std::complex<Float> > Tiles;       // the tiles sent, packed one after another
+
+  public:
+   SparseSpectra() { TileBins=32; TileSlides=8; Threshold=6; Guard=1; Alpha=0.25; Len=0; Slides=0; FreqTiles=0; TimeTiles=0; Sent=0; }
+
+   int Process(const SampleBuffer< std::complex<Float> > &Spectra) // select the tiles: returns the number of tiles selected
+   { if( (TileBins<=0) || (TileSlides<=0) || (Spectra.Len%TileBins) ) return -1;
+     if(Spectra.Len!=Len) Noise.clear();                             // FFT size changed: start the noise floor again
+     Len=Spectra.Len; Slides=Spectra.Full/Len;
+     FreqTiles=Len/TileBins; TimeTiles=(Slides+TileSlides-1)/TileSlides;
+     int MapTiles=TimeTiles*FreqTiles;
+     Energy.assign(MapTiles, 0);
+     for(int Slide=0; Slide<Slides; Slide++)                         // tile energies
+     { const std::complex<Float> *Row = Spectra.Data+Slide*Len;
+       Float *TileRow = &Energy[(Slide/TileSlides)*FreqTiles];
+       for(int Tile=0; Tile<FreqTiles; Tile++)
+       { Float Sum=0;
+         for(int Bin=0; Bin<TileBins; Bin++) Sum+=norm(Row[Bin]);
+         TileRow[Tile]+=Sum; Row+=TileBins; }
+     }
+     int LastSlides = Slides-(TimeTiles-1)*TileSlides;              // the last row of tiles can be shorter: scale it up
+     if( (TimeTiles>0) && (LastSlides<TileSlides) )
+     { Float Scale=(Float)TileSlides/LastSlides;
+       for(int Tile=0; Tile<FreqTiles; Tile++) Energy[(TimeTiles-1)*FreqTiles+Tile]*=Scale; }
+
+     std::vector<Float> Column(TimeTiles);
+     if((int)Noise.size()!=FreqTiles) Noise.assign(FreqTiles, 0);
+     for(int Tile=0; Tile<FreqTiles; Tile++)                         // noise floor per frequency column
+     { if(TimeTiles==0) break;
+       for(int Time=0; Time<TimeTiles; Time++) Column[Time]=Energy[Time*FreqTiles+Tile];
+       std::nth_element(Column.begin(), Column.begin()+TimeTiles/2, Column.end());
+       Float Median=Column[TimeTiles/2];
+       if(Noise[Tile]<=0) Noise[Tile]=Median;
+                     else Noise[Tile]+=Alpha*(Median-Noise[Tile]); }
+     NoiseOut.assign(Noise.begin(), Noise.end());                    // float on the pipe, whatever Float is
+
+     Float Ratio=pow(10.0, 0.1*Threshold);
+     std::vector<uint8_t> Hot(MapTiles, 0);
+     for(int Time=0; Time<TimeTiles; Time++)                         // tiles above the threshold, with the guard around them
+     { for(int Tile=0; Tile<FreqTiles; Tile++)
+       { if(Energy[Time*FreqTiles+Tile]<=Ratio*Noise[Tile]) continue;
+         for(int T=std::max(0, Time-Guard); T<=std::min(TimeTiles-1, Time+Guard); T++)
+           for(int F=std::max(0, Tile-Guard); F<=std::min(FreqTiles-1, Tile+Guard); F++)
+             Hot[T*FreqTiles+F]=1; }
+     }
+
+     Map.assign((MapTiles+7)/8, 0); Sent=0;
+     for(int Idx=0; Idx<MapTiles; Idx++) if(Hot[Idx]) { Map[Idx>>3]|=1<<(Idx&7); Sent++; }
+
+     Tiles.Allocate(Sent*TileSlides*TileBins); Tiles.Full=0; Tiles.Len=TileBins;
+     Tiles.Rate=Spectra.Rate; Tiles.Freq=Spectra.Freq; Tiles.Time=Spectra.Time; Tiles.Date=Spectra.Date;
+     for(int Idx=0; Idx<MapTiles; Idx++)                             // pack the selected tiles: TileSlides rows of TileBins
+     { if(!Hot[Idx]) continue;
+       int Time=Idx/FreqTiles, Tile=Idx%FreqTiles;
+       for(int Slide=Time*TileSlides; Slide<(Time+1)*TileSlides; Slide++)
+       { std::complex<Float> *Dst = Tiles.Data+Tiles.Full;
+         if(Slide<Slides) memcpy(Dst, Spectra.Data+Slide*Len+Tile*TileBins, TileBins*sizeof(std::complex<Float>));
+                     else std::fill(Dst, Dst+TileBins, std::complex<Float>(0, 0)); // beyond the last slide: zeros
+         Tiles.Full+=TileBins; }
+     }
+     return Sent; }
+
+   Float Occupancy(void) const { int Total=TimeTiles*FreqTiles; return Total>0 ? (Float)Sent/Total : 0; }
+
+  template <class StreamType>
+   int Serialize(StreamType File, SpectraEncoder<Float> *Encoder=0)                   // geometry, noise floor, occupancy map, then the tiles as a SampleBuffer:
+                                                    // the data is referenced by Serialize_Gather, thus written before the next Process()
+   { int Total=0, Bytes;
+     int32_t Geometry[6] = { Len, Slides, TileBins, TileSlides, FreqTiles, TimeTiles };
+     Bytes=Serialize_WriteData(File, Geometry, sizeof(Geometry)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, NoiseOut.data(), FreqTiles*sizeof(float)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, Map.data(), Map.size()); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes = Encoder ? Encoder->Serialize(File, Tiles) : Tiles.Serialize(File); if(Bytes<0) return -1;
+     Total+=Bytes;
+     return Total; }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __SPARSESPECTRA_H__
@@ -0,0 +1,202 @@
+#ifndef __SPECENC_H__
+#define __SPECENC_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+#include "buffer.h"
+#include "serialize.h"
+
+// ==================================================================================================
+// Compact encodings of the spectra on the pipe/TCP, instead of 8 bytes (complex float) per bin:
+//  int16 - complex 16-bit integers with a scale per row (slide) = block floating point, 4 bytes per bin
+//  half  - complex IEEE binary16, 4 bytes per bin
+//  log8  - power only, 8-bit log-magnitude relative to the strongest bin of the row, 1 byte per bin
+// The record name tells the encoding: "Spectra" = float as before, "Spectra/int16", "Spectra/half", "Spectra/log8".
+// Encoded block: int32 Encoding, Full, Len; double Rate, Time, Freq; float Scale[Full/Len] (int16, log8); the data.
+
+class SpectraEncoding
+{ public:
+   enum { Float=0, Int16=1, Half=2, Log8=3, Encodings=4 };
+
+   static float Log8_Step(void) { return 0.375; } // [dB] per code of the log8 encoding: 256 codes = 96 dB below the strongest bin
+
+   static const char *Name(int Encoding)
+   { static const char *Names[Encodings] = { "float", "int16", "half", "log8" };
+     return (Encoding>=0) && (Encoding<Encodings) ? Names[Encoding]:0; }
+
+   static int getEncoding(const char *Name)       // -1 when not known
+   { for(int Encoding=0; Encoding<Encodings; Encoding++)
+       if(strcmp(Name, SpectraEncoding::Name(Encoding))==0) return Encoding;
+     return -1; }
+
+   static int BytesPerBin(int Encoding)
+   { static const int Bytes[Encodings] = { 8, 4, 4, 1 };
+     return Bytes[Encoding]; }
+
+   static int RecordName(char *Out, const char *Base, int Encoding) // e.g. "Spectra/int16"
+   { if(Encoding==Float) return sprintf(Out, "%s", Base);
+     return sprintf(Out, "%s/%s", Base, Name(Encoding)); }
+
+   static int ParseName(const char *Record, char *Base, int MaxLen) // split a record name: returns the encoding or -1
+   { const char *Slash=strchr(Record, '/');
+     int Len = Slash ? Slash-Record : strlen(Record); if(Len>=MaxLen) return -1;
+     memcpy(Base, Record, Len); Base[Len]=0;
+     return Slash ? getEncoding(Slash+1) : Float; }
+
+   static uint16_t FloatToHalf(float Value)       // round to nearest, subnormals flushed to zero
+   { uint32_t Bits; memcpy(&Bits, &Value, 4);
+     uint16_t Sign = (Bits>>16)&0x8000;
+     int32_t  Exp  = ((Bits>>23)&0xFF)-127+15;
+     uint32_t Mant = Bits&0x7FFFFF;
+     if(((Bits>>23)&0xFF)==0xFF) return Sign|0x7C00|(Mant?0x200:0); // Inf or NaN
+     if(Exp<=0) return Sign;                                        // too small
+     Mant+=0x1000;                                                  // rounding
+     if(Mant&0x800000) { Mant=0; Exp++; }
+     if(Exp>=31) return Sign|0x7C00;                                // too large
+     return Sign|(Exp<<10)|(Mant>>13); }
+
+   static float HalfToFloat(uint16_t Half)
+   { uint32_t Sign = (uint32_t)(Half&0x8000)<<16;
+     uint32_t Exp  = (Half>>10)&0x1F;
+     uint32_t Mant = Half&0x3FF;
+     uint32_t Bits;
+     if(Exp==0) Bits=Sign;                                          // zero (subnormals are not produced)
+     else if(Exp==31) Bits=Sign|0x7F800000|(Mant<<13);
+     else Bits=Sign|((Exp-15+127)<<23)|(Mant<<13);
+     float Value; memcpy(&Value, &Bits, 4); return Value; }
+
+} ;
+
+template <class Float>
+ class SpectraEncoder                              // writer side
+{ public:
+   int Encoding;
+   std::vector<float>   Scale;                     // per row: BFP scale (int16) or reference level [dB] (log8)
+   std::vector<uint8_t> Data;                      // the encoded bins
+
+  public:
+   SpectraEncoder() { Encoding=SpectraEncoding::Float; }
+
+   int Encode(const SampleBuffer< std::complex<Float> > &Spectra) // returns the number of bytes of the encoded bins
+   { if(Encoding==SpectraEncoding::Float) { Scale.resize(0); Data.resize(0); return Spectra.Full*sizeof(std::complex<Float>); } // sent as it is
+     int Rows = Spectra.Len>0 ? Spectra.Full/Spectra.Len : 0;
+     Data.resize((size_t)Spectra.Full*SpectraEncoding::BytesPerBin(Encoding));
+     if(Encoding==SpectraEncoding::Int16)
+     { Scale.resize(Rows);
+       int16_t *Out=(int16_t *)Data.data();
+       for(int Row=0; Row<Rows; Row++)
+       { const std::complex<Float> *Inp=Spectra.Data+Row*Spectra.Len;
+         Float Max=0;
+         for(int Bin=0; Bin<Spectra.Len; Bin++)
+         { Float Re=fabs(Inp[Bin].real()), Im=fabs(Inp[Bin].imag());
+           if(Re>Max) Max=Re;
+           if(Im>Max) Max=Im; }
+         float RowScale = Max>0 ? Max/32767 : 1; Scale[Row]=RowScale;
+         Float Mult = 1/RowScale;
+         for(int Bin=0; Bin<Spectra.Len; Bin++)
+         { *Out++ = (int16_t)floor(Inp[Bin].real()*Mult+0.5);
+           *Out++ = (int16_t)floor(Inp[Bin].imag()*Mult+0.5); }
+       }
+     }
+     else if(Encoding==SpectraEncoding::Half)
+     { Scale.resize(0);
+       uint16_t *Out=(uint16_t *)Data.data();
+       for(int Bin=0; Bin<Spectra.Full; Bin++)
+       { *Out++ = SpectraEncoding::FloatToHalf(Spectra.Data[Bin].real());
+         *Out++ = SpectraEncoding::FloatToHalf(Spectra.Data[Bin].imag()); }
+     }
+     else if(Encoding==SpectraEncoding::Log8)
+     { Scale.resize(Rows);
+       uint8_t *Out=Data.data();
+       for(int Row=0; Row<Rows; Row++)
+       { const std::complex<Float> *Inp=Spectra.Data+Row*Spectra.Len;
+         Float Max=0;
+         for(int Bin=0; Bin<Spectra.Len; Bin++) { Float Power=norm(Inp[Bin]); if(Power>Max) Max=Power; }
+         float Ref = Max>0 ? 10*log10(Max) : 0; Scale[Row]=Ref;   // [dB] code 255
+         for(int Bin=0; Bin<Spectra.Len; Bin++)
+         { Float Power=norm(Inp[Bin]);
+           int Code = 0;
+           if(Power>0) { Code = 255-(int)floor((Ref-10*log10(Power))/SpectraEncoding::Log8_Step()+0.5); if(Code<0) Code=0; }
+           *Out++ = Code; }                                        // 0 = below the range
+       }
+     }
+     return Data.size(); }
+
+  template <class StreamType>
+   int Serialize(StreamType File, SampleBuffer< std::complex<Float> > &Spectra) // Encode() first: the data is referenced by Serialize_Gather
+   { if(Encoding==SpectraEncoding::Float) return Spectra.Serialize(File);   // as before: a SampleBuffer
+     int Total=0, Bytes;
+     int32_t Geometry[3] = { Encoding, Spectra.Full, Spectra.Len };
+     double  Header[3]   = { Spectra.Rate, Spectra.Time+Spectra.Date, Spectra.Freq };
+     Bytes=Serialize_WriteData(File, Geometry, sizeof(Geometry)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     Bytes=Serialize_WriteData(File, Header, sizeof(Header)); if(Bytes<0) return -1;
+     Total+=Bytes;
+     if(Scale.size())
+     { Bytes=Serialize_WriteData(File, Scale.data(), Scale.size()*sizeof(float)); if(Bytes<0) return -1;
+       Total+=Bytes; }
+     Bytes=Serialize_WriteData(File, Data.data(), Data.size()); if(Bytes<0) return -1;
+     Total+=Bytes;
+     return Total; }
+
+} ;
+
+template <class Float>
+ class SpectraDecoder                              // reader side: decodes an encoded block from a Serialize_Reader
+{ public:
+   int   Encoding;
+   const float   *Scale;                           // in the reader's buffer: valid until its next read
+   const uint8_t *Data;
+
+  public:
+   SpectraDecoder() { Encoding=SpectraEncoding::Float; Scale=0; Data=0; }
+
+   int Read(Serialize_Reader *File, SampleBuffer< std::complex<Float> > &Spectra) // for a record named with an encoding
+   { const uint8_t *Head=(const uint8_t *)File->Get(3*sizeof(int32_t)+3*sizeof(double)); if(Head==0) return -1;
+     int32_t Geometry[3]; double Header[3];
+     memcpy(Geometry, Head, sizeof(Geometry)); memcpy(Header, Head+sizeof(Geometry), sizeof(Header));
+     Encoding=Geometry[0]; int Full=Geometry[1], Len=Geometry[2];
+     if( (Encoding<=SpectraEncoding::Float) || (Encoding>=SpectraEncoding::Encodings) || (Full<0) || (Len<=0) || (Full%Len) ) return -1;
+     int Rows=Full/Len;
+     uint64_t ScaleSize = (Encoding==SpectraEncoding::Half) ? 0 : (uint64_t)Rows*sizeof(float);
+     uint64_t DataSize  = (uint64_t)Full*SpectraEncoding::BytesPerBin(Encoding);
+     if( (ScaleSize+DataSize>(uint64_t)Serialize_MaxRecord)
+      || ((uint64_t)Full*sizeof(std::complex<Float>)>(uint64_t)Serialize_MaxRecord) ) return -1; // protect against corrupted data
+     int ScaleBytes=ScaleSize, DataBytes=DataSize;
+     const uint8_t *Block=(const uint8_t *)File->GetAligned(ScaleBytes+DataBytes); if(Block==0) return -1;
+     Scale=(const float *)Block; Data=Block+ScaleBytes;
+     Spectra.Len=Len; Spectra.Rate=Header[0]; Spectra.Date=(uint32_t)floor(Header[1]); Spectra.Time=Header[1]-Spectra.Date; Spectra.Freq=Header[2];
+     if(Spectra.Allocate(Full)==0) return -1;
+     Spectra.Full=Full;
+     if(Encoding==SpectraEncoding::Int16)
+     { const int16_t *Inp=(const int16_t *)Data;
+       for(int Row=0; Row<Rows; Row++)
+       { std::complex<Float> *Out=Spectra.Data+Row*Len; Float RowScale=Scale[Row];
+         for(int Bin=0; Bin<Len; Bin++, Inp+=2) Out[Bin]=std::complex<Float>(RowScale*Inp[0], RowScale*Inp[1]); }
+     }
+     else if(Encoding==SpectraEncoding::Half)
+     { const uint16_t *Inp=(const uint16_t *)Data;
+       for(int Bin=0; Bin<Full; Bin++, Inp+=2)
+         Spectra.Data[Bin]=std::complex<Float>(SpectraEncoding::HalfToFloat(Inp[0]), SpectraEncoding::HalfToFloat(Inp[1]));
+     }
+     else                                                           // log8: no phase, the magnitude goes to the real part
+     { for(int Row=0; Row<Rows; Row++)
+       { std::complex<Float> *Out=Spectra.Data+Row*Len; const uint8_t *Inp=Data+Row*Len;
+         for(int Bin=0; Bin<Len; Bin++) Out[Bin]=std::complex<Float>(sqrt(Power(Row, Inp[Bin])), 0); }
+     }
+     return Full; }
+
+   Float Power(int Row, uint8_t Code) const        // log8: power of a bin
+   { if(Code==0) return 0;
+     return pow(10.0, 0.1*(Scale[Row]-(255-Code)*SpectraEncoding::Log8_Step())); }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __SPECENC_H__
@@ -0,0 +1,72 @@
+#ifndef __STAGESTATS_H__
+#define __STAGESTATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "thread.h"
+
+// ==================================================================================================
+// Rolling statistics of a processing stage over the most recent time slots: CPU time, wall time,
+// time the slot waited in the input queue and the latency from the acquisition of the slot to the output
+// (for a file source: from the moment the slot was read).
+// Add() is called by the stage thread, Get() and Print() by any other (status page, stdin).
+
+class StageStats
+{ public:
+   static const int Window = 256;                   // [slots] the statistics cover this many recent slots
+   enum { CPU=0, Wall=1, Wait=2, Latency=3, Values=4 };
+
+   struct Summary                                   // [sec]
+   { float Mean, P50, P99, Max; } ;
+
+  private:
+   float     Data[Values][Window];
+   uint32_t  Count;                                 // total number of slots added
+   MutEx     Mutex;
+
+  public:
+   StageStats() { Count=0; }
+
+   // [sec] CPU and Wall = processing time, Wait = in the input queue, Latency = from acquisition to output (negative = unknown)
+   void Add(double CPUTime, double WallTime, double WaitTime, double LatencyTime)
+   { Mutex.Lock();
+     int Idx=Count%Window;
+     Data[CPU][Idx]=CPUTime; Data[Wall][Idx]=WallTime; Data[Wait][Idx]=WaitTime; Data[Latency][Idx]=LatencyTime;
+     Count++;
+     Mutex.Unlock(); }
+
+   uint32_t getCount(void) const { return Count; }
+
+   int Get(Summary &Sum, int Value)                 // returns the number of slots in the summary
+   { float Copy[Window];
+     Mutex.Lock();
+     int Len = Count<(uint32_t)Window ? Count:Window;
+     memcpy(Copy, Data[Value], Len*sizeof(float));
+     Mutex.Unlock();
+     int Valid=0;
+     for(int Idx=0; Idx<Len; Idx++) if(Copy[Idx]>=0) Copy[Valid++]=Copy[Idx];
+     Sum.Mean=0; Sum.P50=0; Sum.P99=0; Sum.Max=0;
+     if(Valid==0) return 0;
+     double Total=0; for(int Idx=0; Idx<Valid; Idx++) Total+=Copy[Idx];
+     Sum.Mean=Total/Valid;
+     std::sort(Copy, Copy+Valid);
+     Sum.P50=Copy[(Valid-1)/2]; Sum.P99=Copy[(99*(Valid-1))/100]; Sum.Max=Copy[Valid-1];
+     return Valid; }
+
+   static const char *Name(int Value)
+   { static const char *Names[Values] = { "CPU", "Wall", "Wait", "Latency" };
+     return Names[Value]; }
+
+   int Print(char *Out, int Value)                  // "mean/p50/p99/max" in [ms]
+   { Summary Sum; if(Get(Sum, Value)==0) return sprintf(Out, "-");
+     return sprintf(Out, "%5.1f/%5.1f/%5.1f/%5.1f", 1e3*Sum.Mean, 1e3*Sum.P50, 1e3*Sum.P99, 1e3*Sum.Max); }
+
+} ;
+
+// ==================================================================================================
+
+#endif // __STAGESTATS_H__
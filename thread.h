@@ -28,8 +28,20 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <alloca.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 #include <queue>
+#include <vector>
 
 // ======================================================================================
 
@@ -134,12 +146,61 @@ template <class Type>
 
 } ;
 
+class QueueControl               // depth, overflow policy and statistics of an object queue
+{ public:
+   enum { DropNewest=0, DropOldest=1, Block=2 };
+   int      Depth;                // [objects] max. number of objects waiting in the queue
+   int      Policy;               // what to do with a new object when the queue is full
+   int      HighWater;            // [objects] from this size on the producer should reduce the load
+   uint32_t Enqueued;             // objects put into the queue
+   uint32_t Dropped;              // objects dropped because the queue was full: counted by both the producer and the consumer
+   uint32_t Recycled;             // objects given back by the consumer
+   uint32_t Blocked;              // times the producer had to wait for space (Block policy)
+   int      MaxSize;              // the highest queue size seen
+
+  public:
+   QueueControl(int Depth=4, int Policy=DropNewest, int HighWater=2)
+   { this->Depth=Depth; this->Policy=Policy; this->HighWater=HighWater;
+     Enqueued=0; Dropped=0; Recycled=0; Blocked=0; MaxSize=0; }
+
+   static const char *PolicyName(int Policy)
+   { static const char *Name[3] = { "drop-newest", "drop-oldest", "block" };
+     return (Policy>=0) && (Policy<3) ? Name[Policy]:"?"; }
+
+   static int getPolicy(const char *Name)          // returns -1 for an unknown name
+   { for(int Policy=0; Policy<3; Policy++)
+       if(strcmp(Name, PolicyName(Policy))==0) return Policy;
+     return -1; }
+
+   template <class Queue, class Type>              // by the producer: push according to the policy, returns 1 when queued, 0 when dropped
+    int Offer(Queue &Q, Type *Obj)
+   { if(Q.Size()>=Depth)
+     { if(Policy==Block) { Blocked++; while(Q.Size()>=Depth) usleep(1000); }
+       else if( (Policy==DropNewest) || (Q.Size()>=2*Depth) ) { Q.Drop(Obj); CountDropped(); return 0; }
+     }                                             // DropOldest: queue it anyway (up to twice the depth), Take() skips the oldest
+     if(Q.Push(Obj)<0) { CountDropped(); return 0; }
+     Enqueued++;
+     int Size=Q.Size(); if(Size>MaxSize) MaxSize=Size;
+     return 1; }
+
+   template <class Queue, class Type>              // by the consumer: pop, with DropOldest the objects over the depth are skipped
+    void Take(Queue &Q, Type *&Obj)
+   { Obj=Q.Pop();
+     if(Policy!=DropOldest) return;
+     while(Q.Size()>=Depth) { Q.Recycle(Obj); CountDropped(); Obj=Q.Pop(); }
+   }
+
+   void CountDropped(void) { __atomic_add_fetch(&Dropped, 1, __ATOMIC_RELAXED); }
+
+} ;
+
 template <class Type>
  class ReuseObjectQueue           // this object queue holds objects
 { public:                         // that can be reused - thus don't need to be created and deleted all the time
    std::queue<Type *> Queue;      // objects in the queue
    std::queue<Type *> Reuse;      // objects to be reused, these can be queued again
    Condition          Cond;
+   QueueControl       Ctrl;       // depth, policy and statistics for Offer() and Take()
 
   public:
 
@@ -158,11 +219,14 @@ template <class Type>
      Cond.Unlock();
      return Obj; }
 
-   void Push(Type *Obj)
+   int Push(Type *Obj)
    { Cond.Lock();
      Queue.push(Obj);
      Cond.Unlock();
-     Cond.Signal(); }
+     Cond.Signal(); return 0; }
+
+   int Offer(Type *Obj) { return Ctrl.Offer(*this, Obj); }  // Push() within the depth and policy
+   Type *Take(void) { Type *Obj; Ctrl.Take(*this, Obj); return Obj; } // Pop() which follows the policy
 
    Type *Pop(void)
    { Cond.Lock();
@@ -172,16 +236,153 @@ template <class Type>
 
    void Recycle(Type *Obj)
    { Cond.Lock();
-     Reuse.push(Obj);
+     Reuse.push(Obj); Ctrl.Recycled++;
      Cond.Unlock();
      Cond.Signal(); }
 
+   void Drop(Type *Obj)           // give back an object which was taken with New() but not pushed
+   { Cond.Lock();
+     Reuse.push(Obj);
+     Cond.Unlock(); }
+
+   void Reserve(Type *Obj) { Drop(Obj); } // an object prepared in advance for New(), thus New() does not allocate
+
    int Size(void)
    { Cond.Lock();
      int size = Queue.size();
      Cond.Unlock();
      return size; }
 
+   int Capacity(void) const { return INT_MAX; }
+
+} ;
+
+// ======================================================================================
+
+class Doorbell                    // wakes up one waiting thread without a mutex: futex on Linux, polling elsewhere
+{ private:                        // the waiter: Seq=Prepare(); check the condition again; Wait(Seq) (or Cancel())
+   uint32_t Seq;                  // incremented by every Ring()
+   int      Waiting;              // [bool] someone prepared to wait: Ring() has to make the system call
+
+  public:
+   Doorbell() { Seq=0; Waiting=0; }
+
+   uint32_t Prepare(void)
+   { uint32_t Now=__atomic_load_n(&Seq, __ATOMIC_SEQ_CST);
+     __atomic_store_n(&Waiting, 1, __ATOMIC_SEQ_CST);
+     return Now; }
+
+   void Cancel(void) { __atomic_store_n(&Waiting, 0, __ATOMIC_RELAXED); }
+
+   void Wait(uint32_t Prepared)   // returns at once when there was a Ring() after Prepare()
+   {
+#ifdef __linux__
+     syscall(SYS_futex, &Seq, FUTEX_WAIT_PRIVATE, Prepared, 0, 0, 0);
+#else
+     if(__atomic_load_n(&Seq, __ATOMIC_SEQ_CST)==Prepared) usleep(1000);
+#endif
+     Cancel(); }
+
+   void Ring(void)
+   { __atomic_add_fetch(&Seq, 1, __ATOMIC_SEQ_CST);
+     if(__atomic_load_n(&Waiting, __ATOMIC_SEQ_CST)==0) return;    // nobody waiting: no system call
+#ifdef __linux__
+     syscall(SYS_futex, &Seq, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#endif
+   }
+
+} ;
+
+template <class Type>
+ class SPSC_Ring                  // bounded lock-free ring of pointers for one producer and one consumer thread
+{ private:
+   Type   **Slot;
+   uint32_t Mask;                 // number of slots minus one, the number of slots is a power of two
+   char     Pad0[64];
+   uint32_t Head;                 // consumer position: free running
+   char     Pad1[64];
+   uint32_t Tail;                 // producer position: free running
+   char     Pad2[64];
+
+  public:
+   SPSC_Ring(int Size=16)
+   { uint32_t Slots=1; while(Slots<(uint32_t)Size) Slots<<=1;
+     Slot = new Type* [Slots]; Mask=Slots-1; Head=0; Tail=0; }
+  ~SPSC_Ring() { delete [] Slot; }
+
+   int Push(Type *Obj)            // by the producer: returns -1 when full
+   { uint32_t Pos=__atomic_load_n(&Tail, __ATOMIC_RELAXED);
+     if( (Pos-__atomic_load_n(&Head, __ATOMIC_ACQUIRE)) > Mask ) return -1;
+     Slot[Pos&Mask]=Obj;
+     __atomic_store_n(&Tail, Pos+1, __ATOMIC_SEQ_CST); return 0; }
+
+   Type *Pop(void)                // by the consumer: returns 0 when empty
+   { uint32_t Pos=__atomic_load_n(&Head, __ATOMIC_RELAXED);
+     if(Pos==__atomic_load_n(&Tail, __ATOMIC_SEQ_CST)) return 0;
+     Type *Obj=Slot[Pos&Mask];
+     __atomic_store_n(&Head, Pos+1, __ATOMIC_RELEASE); return Obj; }
+
+   int Size(void)                 // by any thread
+   { return __atomic_load_n(&Tail, __ATOMIC_ACQUIRE)-__atomic_load_n(&Head, __ATOMIC_ACQUIRE); }
+
+   int Capacity(void) const { return Mask+1; }
+
+} ;
+
+template <class Type>
+ class SPSC_ReuseObjectQueue      // same as ReuseObjectQueue, but lock-free for exactly one producer and one consumer thread:
+{ private:                        // New(), Push() and Drop() by the producer, Pop() and Recycle() by the consumer
+   SPSC_Ring<Type>    Queue;      // objects in the queue
+   SPSC_Ring<Type>    Reuse;      // objects given back by the consumer
+   std::vector<Type*> Spare;      // objects given back by the producer itself, accessed only by the producer
+   Doorbell           Bell;       // the consumer waits here when the queue is empty
+
+  public:
+   QueueControl       Ctrl;       // depth, policy and statistics for Offer() and Take()
+
+  public:
+   SPSC_ReuseObjectQueue(int Size=64) : Queue(Size), Reuse(Size) { }
+
+  ~SPSC_ReuseObjectQueue()
+   { Type *Obj;
+     while((Obj=Queue.Pop())) delete Obj;
+     while((Obj=Reuse.Pop())) delete Obj;
+     for(size_t Idx=0; Idx<Spare.size(); Idx++) delete Spare[Idx]; }
+
+   Type *New(void)                // never blocks: takes a recycled object or creates a new one
+   { if(!Spare.empty()) { Type *Obj=Spare.back(); Spare.pop_back(); return Obj; }
+     Type *Obj=Reuse.Pop(); if(Obj) return Obj;
+     return new Type; }
+
+   int Push(Type *Obj)            // never blocks: when the ring is full the object is dropped and -1 returned
+   { if(Queue.Push(Obj)<0) { Drop(Obj); return -1; }
+     Bell.Ring(); return 0; }
+
+   int Offer(Type *Obj) { return Ctrl.Offer(*this, Obj); }  // Push() within the depth and policy
+   Type *Take(void) { Type *Obj; Ctrl.Take(*this, Obj); return Obj; } // Pop() which follows the policy
+
+   Type *Pop(void)                // blocks until there is an object in the queue
+   { for( ; ; )
+     { Type *Obj=Queue.Pop(); if(Obj) return Obj;
+       uint32_t Seq=Bell.Prepare();
+       Obj=Queue.Pop(); if(Obj) { Bell.Cancel(); return Obj; }
+       pthread_testcancel();
+       Bell.Wait(Seq); }
+   }
+
+   void Recycle(Type *Obj)        // by the consumer
+   { Ctrl.Recycled++;
+     if(Reuse.Push(Obj)<0) delete Obj; }
+
+   void Drop(Type *Obj)           // by the producer: an object taken with New() but not pushed
+   { Spare.push_back(Obj); }
+
+   void Reserve(Type *Obj)        // an object prepared in advance for New(): before the producer thread starts
+   { Spare.push_back(Obj); }
+
+   int Size(void) { return Queue.Size(); }
+   int Capacity(void) const { return Queue.Capacity(); }
+
 } ;
 
 // ======================================================================================
@@ -260,4 +461,90 @@ class Thread
 
 // ======================================================================================
 
+class ThreadProfile               // CPU affinity and scheduling of a thread: applied by the thread itself when it starts
+{ public:
+   uint64_t CPUs;                 // bit mask of the CPUs to run on, zero = all
+   int      Policy;               // SCHED_OTHER, SCHED_FIFO, SCHED_RR, SCHED_BATCH, SCHED_IDLE or -1 = leave as it is
+   int      Priority;             // for SCHED_FIFO and SCHED_RR, -1 = the highest
+   int      StackPrefault;        // [KB] stack to touch at the start, thus no page faults later
+
+  public:
+   ThreadProfile(int Policy=(-1), int Priority=0) { CPUs=0; this->Policy=Policy; this->Priority=Priority; StackPrefault=0; }
+
+   static const char *PolicyName(int Policy)
+   { switch(Policy)
+     { case SCHED_OTHER: return "other";
+       case SCHED_FIFO:  return "fifo";
+       case SCHED_RR:    return "rr";
+#ifdef SCHED_BATCH
+       case SCHED_BATCH: return "batch";
+#endif
+#ifdef SCHED_IDLE
+       case SCHED_IDLE:  return "idle";
+#endif
+     }
+     return "default"; }
+
+   int setPolicy(const char *Name)                  // returns -1 for an unknown name, "default" = leave as it is
+   { static const int List[] = { SCHED_OTHER, SCHED_FIFO, SCHED_RR,
+#ifdef SCHED_BATCH
+                                 SCHED_BATCH,
+#endif
+#ifdef SCHED_IDLE
+                                 SCHED_IDLE,
+#endif
+                                 -1 };
+     for(int Idx=0; ; Idx++)
+     { if(strcmp(Name, PolicyName(List[Idx]))==0) { Policy=List[Idx]; return 0; }
+       if(List[Idx]<0) break; }
+     return -1; }
+
+   int setCPUs(const char *List)                    // like "2", "2,3" or "1-3": returns the number of CPUs or -1
+   { uint64_t Mask=0;
+     while(*List)
+     { char *End; long First=strtol(List, &End, 10); if(End==List) return -1;
+       long Last=First; List=End;
+       if(*List=='-') { List++; Last=strtol(List, &End, 10); if(End==List) return -1; List=End; }
+       if( (First<0) || (Last<First) || (Last>63) ) return -1;
+       for(long CPU=First; CPU<=Last; CPU++) Mask|=(uint64_t)1<<CPU;
+       while( (*List==',') || (*List==' ') ) List++; }
+     CPUs=Mask; return __builtin_popcountll(Mask); }
+
+   int Apply(void) const                            // by the thread itself: returns -1 if something could not be set
+   { int Ret=0;
+#ifdef __linux__
+     if(CPUs)
+     { cpu_set_t Set; CPU_ZERO(&Set);
+       for(int CPU=0; CPU<64; CPU++) if(CPUs&((uint64_t)1<<CPU)) CPU_SET(CPU, &Set);
+       if(pthread_setaffinity_np(pthread_self(), sizeof(Set), &Set)!=0)
+       { printf("ThreadProfile.Apply() ... cannot set CPUs 0x%llX\n", (unsigned long long)CPUs); Ret=(-1); }
+     }
+#endif
+     if(Policy>=0)
+     { struct sched_param Param; Param.sched_priority=0;
+       if( (Policy==SCHED_FIFO) || (Policy==SCHED_RR) )
+         Param.sched_priority = Priority<0 ? sched_get_priority_max(Policy):Priority;
+       if(pthread_setschedparam(pthread_self(), Policy, &Param)!=0)
+       { printf("ThreadProfile.Apply() ... cannot set policy %s, priority %d\n", PolicyName(Policy), Param.sched_priority); Ret=(-1); }
+     }
+     if(StackPrefault>0) TouchStack(StackPrefault*1024);
+     return Ret; }
+
+   int Print(char *Out) const                       // short description for the status page
+   { int Len=sprintf(Out, "%s", PolicyName(Policy));
+     if( (Policy==SCHED_FIFO) || (Policy==SCHED_RR) )
+     { if(Priority<0) Len+=sprintf(Out+Len, " max");
+                 else Len+=sprintf(Out+Len, " %d", Priority); }
+     if(CPUs) Len+=sprintf(Out+Len, ", CPUs 0x%llX", (unsigned long long)CPUs);
+     return Len; }
+
+  private:
+   static void __attribute__((noinline)) TouchStack(int Bytes)
+   { volatile uint8_t *Stack = (volatile uint8_t *)alloca(Bytes);
+     for(int Idx=0; Idx<Bytes; Idx+=1024) Stack[Idx]=0; }
+
+} ;
+
+// ======================================================================================
+
 #endif // of __THREAD_H__